@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+/* Time utf_validstring() over text whose runes end in BF, which the vector
+ * validator must not mistake for the start of a non-character, against similar
+ * text without them. Both should validate at about the same speed. */
+
+#include <utf/utf.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_SZ (16 << 20)
+#define BENCH_RUNS 5
+
+/* Fill buf with copies of the n bytes of pattern, and return the number of bytes
+ * written. */
+static size_t fill_pattern(char* buf, size_t sz, const char* pattern, size_t n)
+{
+    size_t len = 0;
+
+    while (len + n <= sz) {
+        memcpy(&buf[len], pattern, n);
+        len += n;
+    }
+
+    return len;
+}
+
+/* Return the fastest of a few runs of utf_validstring() over the len bytes at
+ * buf, in clock ticks, or -1 if the text does not validate. */
+static clock_t time_validstring(const char* buf, size_t len)
+{
+    clock_t best = 0;
+    clock_t start, ticks;
+    int run;
+
+    for (run = 0; run < BENCH_RUNS; run++) {
+        start = clock();
+        if (!utf_validstring(buf, len)) {
+            return (clock_t)-1;
+        }
+        ticks = clock() - start;
+
+        if (run == 0 || ticks < best) {
+            best = ticks;
+        }
+    }
+
+    return best;
+}
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        const char* pattern;
+    } texts[] = {
+        { "plain", "\xD1\x81\xD1\x80\xD0\xB8\xD1\x81" },
+        { "cyrillic", "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xBF" },
+        { "cjk", "\xE4\xB8\xBF\xE4\xB8\x80\xE4\xB8\xBF" }
+    };
+    char* buf = malloc(BENCH_SZ);
+    clock_t base = 0;
+    clock_t ticks;
+    size_t len, i;
+
+    if (!buf) {
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        len = fill_pattern(buf, BENCH_SZ, texts[i].pattern,
+                           strlen(texts[i].pattern));
+        ticks = time_validstring(buf, len);
+        if (ticks == (clock_t)-1) {
+            fprintf(stderr, "%s: text did not validate\n", texts[i].name);
+            free(buf);
+            return EXIT_FAILURE;
+        }
+        if (i == 0) {
+            base = ticks;
+        }
+
+        printf("%-10s %8.2f ms %6.2fx\n", texts[i].name,
+               1000.0 * (double)ticks / CLOCKS_PER_SEC,
+               base ? (double)ticks / (double)base : 1.0);
+    }
+
+    free(buf);
+    return EXIT_SUCCESS;
+}
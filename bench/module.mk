@@ -0,0 +1,27 @@
+CUR_LIST_DIR     := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+
+BENCH_LIST_DIR := $(CUR_LIST_DIR)
+
+BENCH_SRCS     := bench_validate.c
+
+BENCH_SRCS     := $(addprefix $(BENCH_LIST_DIR)/,$(BENCH_SRCS))
+BENCH_OBJDIR   := $(addprefix $(OBJDIR)/,$(BENCH_LIST_DIR))
+BENCH_BINS     := $(addprefix $(OBJDIR)/,$(BENCH_SRCS:.c=$(EXEEXT)))
+
+$(BENCH_OBJDIR): | $(OBJDIR)
+	@mkdir $(BENCH_OBJDIR)
+
+$(BENCH_OBJDIR)/%.o: $(BENCHDIR)/%.c | $(BENCH_OBJDIR)
+	$(COMPILE.c) -fPIC $(OUTPUT_OPTION) $^
+
+$(BENCH_BINS): LINKFLAGS += -L. -l$(NAME)
+$(BENCH_OBJDIR)/%$(EXEEXT): $(BENCH_OBJDIR)/%.o | $(STATIC_LIB) $(SHARED_LIB)
+	$(CC) $(CFLAGS) $(LINKFLAGS) -pie -rdynamic -o $@ $<
+
+# Benchmarks are timed, so they are not part of check.
+bench: all $(BENCH_BINS)
+	@for bench_bin in $(BENCH_BINS); do \
+		$$bench_bin;                    \
+	done
+
+.PHONY: bench
@@ -6,6 +6,7 @@ LIBRARY_TYPE   := shared static
 SRCDIR         := src
 OBJDIR         := build
 TESTDIR        := test
+BENCHDIR       := bench
 EXT_SRCDIR     := third_party
 
 SHELL          := /bin/bash
@@ -16,6 +17,11 @@ VALGRIND       :=
 INCLUDES       := include
 TARGET_MACHINE := x86_64-linux-gnu
 
+# Instruction sets for the vector kernels, e.g. -mssse3, -mavx2 or -march=native.
+# Left empty, the lookup validator, classifier and scanners fall back to SSE2 or
+# scalar code, and validation runs several times slower than with -mavx2.
+ARCH_FLAGS     :=
+
 LIBDIRS        := /lib                             \
 				  /usr/lib                         \
 				  /usr/local/lib                   \
@@ -24,7 +30,7 @@ LIBDIRS        := /lib                             \
 				  /usr/local/lib/$(TARGET_MACHINE)
 EXTRA_LIBDIRS  :=
 
-LIBS           := c m
+LIBS           := c m pthread
 EXTRA_LIBS     :=
 
 INCFLAGS       := $(addprefix -I,$(INCLUDES))
@@ -0,0 +1,219 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_INLINE_H
+#define UTF_INLINE_H
+
+#include "utf.h"
+
+/* Header-only versions of the per-rune primitives in utf.h. They return the
+same results as the functions they are named after, but can be inlined into the
+caller's loops instead of being called through the shared library. Including
+this header is optional. */
+
+#if defined(__GNUC__)
+#  define UTF_INLINE static __inline__
+#else
+#  define UTF_INLINE static inline
+#endif
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Identical to utf_is_pair_start(). */
+UTF_INLINE bool utf_inline_is_pair_start(uint_least32_t w)
+{
+    return w - 0xD800U < 0x400U;
+}
+
+/* Identical to utf_is_pair_end(). */
+UTF_INLINE bool utf_inline_is_pair_end(uint_least32_t w)
+{
+    return w - 0xDC00U < 0x400U;
+}
+
+/* Identical to utf_is_pair(). */
+UTF_INLINE bool utf_inline_is_pair(uint_least32_t w)
+{
+    return w - 0xD800U < 0x800U;
+}
+
+/* Return whether c is not a continuation byte, which is what
+utf_is_rune_start() checks. */
+UTF_INLINE bool utf_inline_is_rune_start(char c)
+{
+    return ((unsigned char)c & 0xC0) != 0x80;
+}
+
+/* Identical to utf_is_valid_rune(). */
+UTF_INLINE bool utf_inline_is_valid_rune(uint_least32_t w)
+{
+    return w <= UTF_MAX_VALUE && w - 0xD800U >= 0x800U &&
+        w - 0xFDD0U >= 0x20U && (w & 0xFFFEU) != 0xFFFEU;
+}
+
+/* Identical to utf_runelen(). */
+UTF_INLINE int utf_inline_runelen(uint_least32_t w)
+{
+    if (w <= UTF_MAX_VALUE) {
+        return 1 + (w > 0x7F) + (w > 0x7FF) + (w > 0xFFFF);
+    }
+
+    if (w < 0x200000 || w > 0x7FFFFFFF) {
+        return -1;
+    }
+
+    return w < 0x4000000 ? 5 : 6;
+}
+
+/* Identical to utf_decoderune_v(): decode the rune at the start of the len
+bytes at src and return it along with its length and the error code. */
+UTF_INLINE utf_decoded_s utf_inline_decoderune(const char* src, int len)
+{
+    const unsigned char* s = (const unsigned char*)src;
+    utf_decoded_s result;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+    int error = UTF_SUCCESS;
+    int n, i;
+
+    result.rune = 0;
+    result.len = 0;
+    result.error = UTF_ETRUNC;
+
+    if (len <= 0) {
+        return result;
+    }
+
+    result.len = 1;
+
+    if (s[0] < 0x80) {
+        result.rune = s[0];
+        result.error = UTF_SUCCESS;
+        return result;
+    }
+
+    if (s[0] < 0xC2) {
+        result.error = s[0] < 0xC0 ? UTF_ESTART : UTF_ELEN;
+        return result;
+    }
+
+    if (s[0] > 0xF4) {
+        result.error = s[0] < 0xFE ? UTF_ELIMIT : UTF_EVALUE;
+        return result;
+    }
+
+    n = s[0] < 0xE0 ? 2 : s[0] < 0xF0 ? 3 : 4;
+
+    /* The leads whose second byte is restricted, as in RFC 3629. */
+    switch (s[0]) {
+        case 0xE0: lo = 0xA0; error = UTF_ELEN; break;
+        case 0xED: hi = 0x9F; error = UTF_ESEQ; break;
+        case 0xF0: lo = 0x90; error = UTF_ELEN; break;
+        case 0xF4: hi = 0x8F; error = UTF_ELIMIT; break;
+        default: break;
+    }
+
+    result.rune = (utf_rune)(s[0] & (0x7F >> n));
+
+    for (i = 1; i < n; i++) {
+        if (i >= len) {
+            result.rune = 0;
+            result.len = len;
+            return result;
+        }
+
+        if ((s[i] & 0xC0) != 0x80 ||
+                (i == 1 && (s[1] < lo || s[1] > hi))) {
+            result.rune = 0;
+            result.len = i;
+            result.error = (i == 1 && (s[1] & 0xC0) == 0x80) ? error
+                                                             : UTF_ESEQ;
+            return result;
+        }
+
+        result.rune = result.rune << 6 | (utf_rune)(s[i] & 0x3F);
+    }
+
+    result.len = n;
+    result.error = UTF_SUCCESS;
+
+    if (!utf_inline_is_valid_rune(result.rune)) {
+        result.rune = 0;
+        result.error = UTF_ESEQ;
+    }
+
+    return result;
+}
+
+/* Encode r at the start of dest, which must have room for 4 bytes, and return
+the number of bytes written. Unlike utf_encoderune(), a rune that is not valid
+by utf_is_valid_rune() is not encoded, and 0 is returned for it. */
+UTF_INLINE int utf_inline_encoderune(char* dest, utf_rune r)
+{
+    unsigned char* s = (unsigned char*)dest;
+
+    if (r < 0x80) {
+        s[0] = (unsigned char)r;
+        return 1;
+    }
+
+    if (r < 0x800) {
+        s[0] = (unsigned char)(0xC0 | (r >> 6));
+        s[1] = (unsigned char)(0x80 | (r & 0x3F));
+        return 2;
+    }
+
+    if (!utf_inline_is_valid_rune(r)) {
+        return 0;
+    }
+
+    if (r < 0x10000) {
+        s[0] = (unsigned char)(0xE0 | (r >> 12));
+        s[1] = (unsigned char)(0x80 | ((r >> 6) & 0x3F));
+        s[2] = (unsigned char)(0x80 | (r & 0x3F));
+        return 3;
+    }
+
+    s[0] = (unsigned char)(0xF0 | (r >> 18));
+    s[1] = (unsigned char)(0x80 | ((r >> 12) & 0x3F));
+    s[2] = (unsigned char)(0x80 | ((r >> 6) & 0x3F));
+    s[3] = (unsigned char)(0x80 | (r & 0x3F));
+    return 4;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#pragma clang diagnostic pop
+
+#endif /* UTF_INLINE_H */
@@ -34,12 +34,18 @@ SPDX-License-Identifier: MIT
 #define UTF_RUNE_C(c) UINT32_C(c)
 typedef uint_least32_t utf_rune;
 
+/* A UTF-16 code unit. */
+typedef unsigned short utf_char16;
+
 /* UTF rune value ranges, defined by RFC-3629. */
 #define UTF_BYTES_MAX 6
 #define UTF_ASCII_MAX UTF_RUNE_C(0x7F)
 #define UTF_UTF8_MIN UTF_RUNE_C(0x80)
 #define UTF_MAX_VALUE UTF_RUNE_C(0x10FFFF)
 
+/* U+FFFD REPLACEMENT CHARACTER, substituted for malformed input. */
+#define UTF_REPLACEMENT_CHAR UTF_RUNE_C(0xFFFD)
+
 #define UTF_API __attribute__((visibility("default")))
 
 #pragma clang diagnostic push
@@ -56,7 +62,8 @@ typedef uint_least32_t utf_rune;
 #define UTF_ELEN    4
 #define UTF_ESEQ    5
 #define UTF_ELIMIT  6
-#define UTF_MAX_ERRNO UTF_ELIMIT
+#define UTF_ERANGE  7
+#define UTF_MAX_ERRNO UTF_ERANGE
 
 
 #ifdef __cplusplus
@@ -64,6 +71,31 @@ extern "C" {
 #endif /* __cplusplus */
 
 
+/*
+ * Memory allocation
+ */
+
+/* Memory functions for the library to allocate with, each passed user along
+with the arguments of its standard C counterpart and the size of the block it
+works on, so that an arena can track its blocks. The library allocates every
+block at its final size, so blocks are never resized. */
+typedef struct utf_allocator_s {
+    void* (*alloc)(void* user, size_t size);
+    void (*free)(void* user, void* p, size_t size);
+    void* user;
+} utf_allocator_s;
+
+/* Make a copy of allocator the one used by every function that allocates
+without being given one, or restore malloc() and free() if it is a null
+pointer. Memory allocated before the call is still released with the allocator
+that allocated it. This must not be called while other threads are allocating
+through the library. */
+UTF_API void utf_set_allocator(const utf_allocator_s* allocator);
+
+/* Return the allocator used by default. */
+UTF_API const utf_allocator_s* utf_get_allocator(void);
+
+
 /*
  * Decoder/Encoder state
  */
@@ -72,10 +104,16 @@ extern int utf_errno;
 typedef struct utf_state_s utf_state_s;
 typedef struct utf_state_s* utf_state_p;
 
-/* Return a newly-constructed state struct for use in reentrant functions. */
+/* Return a newly-constructed state struct for use in reentrant functions, or a
+null pointer if it could not be allocated. */
 UTF_API utf_state_p utf_state_new(void);
 
-/* Destroy and deallocate a state struct. */
+/* Identical to utf_state_new(), except that the state is allocated with
+allocator, or with the default allocator if it is a null pointer. */
+UTF_API utf_state_p utf_state_new_with(const utf_allocator_s* allocator);
+
+/* Destroy and deallocate a state struct with the allocator it was allocated
+with. */
 UTF_API void utf_state_destroy(utf_state_p state);
 
 /* Clear a state struct to reuse as if newly-created. */
@@ -115,19 +153,53 @@ UTF_API bool utf_is_valid_rune(uint_least32_t w);
 not guarantee that s is a valid UTF string. */
 UTF_API bool utf_is_full_rune(const char* s, size_t len);
 
-/* Return the number of runes (not bytes) in s. */
+/* Return the number of runes (not bytes) in the len bytes at s. Every byte that
+is not a continuation byte counts as a rune, and s is not validated. */
 UTF_API size_t utf_runecount(const char* s, size_t len);
 
-/* Return whether s is a valid UTF string. */
+/* Identical to utf_runecount(), except that s is validated in the same pass.
+Return whether s is valid, as by utf_validstring(), and unless count is a null
+pointer, store in it the number of runes before the first malformed sequence. */
+UTF_API bool utf_runecount_valid(const char* s, size_t len, size_t* count);
+
+/* Return whether the len bytes at s are a valid UTF string. Every sequence
+rejected by utf_decoderune_r(), including surrogates and non-characters, makes
+the string invalid. */
 UTF_API bool utf_validstring(const char* s, size_t len);
 
+/* Where and why validation by utf_validate_ex() stopped. */
+typedef struct utf_validation_s {
+    size_t offset;  /* Offset of the first malformed sequence, or the length. */
+    size_t runes;   /* Number of runes before offset. */
+    int error;      /* UTF_E* code of the sequence, or UTF_SUCCESS. */
+} utf_validation_s;
+
+/* Identical to utf_validstring(), except that result is filled in with the
+offset and error code of the first malformed sequence and the number of runes
+before it, all found in the same pass. A null s is reported as UTF_EVALUE at
+offset 0. */
+UTF_API bool utf_validate_ex(const char* s, size_t len,
+                             utf_validation_s* result);
+
+/* Identical to utf_validate_ex(), except that a large s is split at rune
+boundaries into chunks that are validated in parallel by up to threads threads.
+If threads is 0 or less, one thread per online processor is used. */
+UTF_API bool utf_validate_mt(const char* s, size_t len,
+                             utf_validation_s* result, int threads);
+
 /* Return the number of bytes required to encode a single word to a UTF rune. */
 UTF_API int utf_runelen(uint_least32_t w);
 
-/* Return the number of bytes required to encode all bytes up to len in s to
-UTF runes. */
+/* Return the number of bytes taken up by the first len runes in the
+null-terminated string s, or the length of s if it has fewer runes than that.
+s is read only as far as those runes, and the result is capped at INT_MAX. */
 UTF_API int utf_runenlen(const char* s, size_t len);
 
+/* Return the number of UTF-16 code units needed for the len bytes at s, which
+is the number of runes, as by utf_runecount(), plus one for every rune above
+U+FFFF. s is not validated. */
+UTF_API size_t utf_utf16len(const char* s, size_t len);
+
 /* Return whether r is either a digit or alphabetic. */
 UTF_API bool utf_isalnum(utf_rune r);
 
@@ -182,51 +254,408 @@ UTF_API bool utf_ismath(utf_rune r);
 /* Return whether r is a hex digit. */
 UTF_API bool utf_isxdigit(utf_rune r);
 
+/* Character classes, as bits of the mask returned by utf_properties(). Each is
+set for exactly the runes that its utf_is*() function is true for. */
+#define UTF_CLASS_ALPHA    UINT32_C(0x00001)  /* utf_isalpha() */
+#define UTF_CLASS_DIGIT    UINT32_C(0x00002)  /* utf_isdigit() */
+#define UTF_CLASS_ALNUM    UINT32_C(0x00004)  /* utf_isalnum() */
+#define UTF_CLASS_NUMBER   UINT32_C(0x00008)  /* utf_isnumber() */
+#define UTF_CLASS_INTEGER  UINT32_C(0x00010)  /* utf_isinteger() */
+#define UTF_CLASS_CNTRL    UINT32_C(0x00020)  /* utf_iscntrl() */
+#define UTF_CLASS_PRINT    UINT32_C(0x00040)  /* utf_isprint() */
+#define UTF_CLASS_GRAPH    UINT32_C(0x00080)  /* utf_isgraph() */
+#define UTF_CLASS_PUNCT    UINT32_C(0x00100)  /* utf_ispunct() */
+#define UTF_CLASS_BLANK    UINT32_C(0x00200)  /* utf_isblank() */
+#define UTF_CLASS_SPACE    UINT32_C(0x00400)  /* utf_isspace() */
+#define UTF_CLASS_LOWER    UINT32_C(0x00800)  /* utf_islower() */
+#define UTF_CLASS_UPPER    UINT32_C(0x01000)  /* utf_isupper() */
+#define UTF_CLASS_TITLE    UINT32_C(0x02000)  /* utf_istitle() */
+#define UTF_CLASS_SYMBOL   UINT32_C(0x04000)  /* utf_issymbol() */
+#define UTF_CLASS_CURRENCY UINT32_C(0x08000)  /* utf_iscurrency() */
+#define UTF_CLASS_MATH     UINT32_C(0x10000)  /* utf_ismath() */
+#define UTF_CLASS_XDIGIT   UINT32_C(0x20000)  /* utf_isxdigit() */
+
+/* Unicode General_Category values returned by utf_category(). */
+#define UTF_CATEGORY_CN  0  /* Unassigned */
+#define UTF_CATEGORY_LU  1  /* Uppercase_Letter */
+#define UTF_CATEGORY_LL  2  /* Lowercase_Letter */
+#define UTF_CATEGORY_LT  3  /* Titlecase_Letter */
+#define UTF_CATEGORY_LM  4  /* Modifier_Letter */
+#define UTF_CATEGORY_LO  5  /* Other_Letter */
+#define UTF_CATEGORY_MN  6  /* Nonspacing_Mark */
+#define UTF_CATEGORY_MC  7  /* Spacing_Mark */
+#define UTF_CATEGORY_ME  8  /* Enclosing_Mark */
+#define UTF_CATEGORY_ND  9  /* Decimal_Number */
+#define UTF_CATEGORY_NL 10  /* Letter_Number */
+#define UTF_CATEGORY_NO 11  /* Other_Number */
+#define UTF_CATEGORY_PC 12  /* Connector_Punctuation */
+#define UTF_CATEGORY_PD 13  /* Dash_Punctuation */
+#define UTF_CATEGORY_PS 14  /* Open_Punctuation */
+#define UTF_CATEGORY_PE 15  /* Close_Punctuation */
+#define UTF_CATEGORY_PI 16  /* Initial_Punctuation */
+#define UTF_CATEGORY_PF 17  /* Final_Punctuation */
+#define UTF_CATEGORY_PO 18  /* Other_Punctuation */
+#define UTF_CATEGORY_SM 19  /* Math_Symbol */
+#define UTF_CATEGORY_SC 20  /* Currency_Symbol */
+#define UTF_CATEGORY_SK 21  /* Modifier_Symbol */
+#define UTF_CATEGORY_SO 22  /* Other_Symbol */
+#define UTF_CATEGORY_ZS 23  /* Space_Separator */
+#define UTF_CATEGORY_ZL 24  /* Line_Separator */
+#define UTF_CATEGORY_ZP 25  /* Paragraph_Separator */
+#define UTF_CATEGORY_CC 26  /* Control */
+#define UTF_CATEGORY_CF 27  /* Format */
+#define UTF_CATEGORY_CS 28  /* Surrogate */
+#define UTF_CATEGORY_CO 29  /* Private_Use */
+
+/* Return the mask of the UTF_CLASS_* classes that r belongs to, all found with
+a single table lookup. Runes that are unassigned or out of range belong to no
+class. */
+UTF_API uint_least32_t utf_properties(utf_rune r);
+
+/* Return the UTF_CATEGORY_* general category of r, which is UTF_CATEGORY_CN for
+runes that are unassigned or out of range. */
+UTF_API int utf_category(utf_rune r);
+
+/* Store utf_properties() of each of the n runes at runes in the same position
+of flags. */
+UTF_API void utf_classify_n(const utf_rune* runes, size_t n,
+                            uint_least32_t* flags);
+
+/* Decode the n bytes at *src as utf_mbsnrtoufs() does, but store the
+utf_properties() of at most len runes in dest instead of the runes themselves.
+ASCII is classified straight from the bytes without being decoded. *src is
+advanced past the bytes consumed, and the number of runes classified is
+returned. If a malformed sequence is found, classifying stops in front of it and
+utf_errno is set. If dest is a null pointer, nothing is written and len is
+ignored. */
+UTF_API size_t utf_mbsnrclassify(uint_least32_t* dest, const char** src,
+                                 size_t n, size_t len);
+
+/* Find the first rune in the len bytes of UTF-8 at s that is in any of the
+UTF_CLASS_* classes in class_mask, and store its byte offset in *offset. ASCII
+is tested many bytes at a time without being decoded. Return whether one was
+found; if not, *offset is len, or the offset of a malformed sequence that came
+first, in which case utf_errno is set. */
+UTF_API bool utf_find_class(const char* s, size_t len,
+                            uint_least32_t class_mask, size_t* offset);
+
+/* Return the length in bytes of the longest prefix of the len bytes of UTF-8 at
+s whose runes are all in at least one of the UTF_CLASS_* classes in class_mask,
+as utf_find_class() finds it. If the prefix ends at a malformed sequence,
+utf_errno is set. */
+UTF_API size_t utf_span_class(const char* s, size_t len,
+                              uint_least32_t class_mask);
+
 
 /*
  * Encoding functions
  */
 
-/* Convert a single rune to its corresponding word. */
-UTF_API int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
+/* Convert a single rune to its corresponding word. If dest is a null pointer,
+nothing is written and only the length of the word is returned. */
+UTF_API int utf_encoderune_r(char* restrict dest, utf_rune* restrict src,
                              utf_state_p state);
-UTF_API int utf_encoderune(char* dest restrict, utf_rune* src restrict);
-
-/* Copy from src to dest one byte at a time. */
-UTF_API int utf_utfsrtombs(char* dest, const utf_rune* src);
-
-/* Copy up to n bytes from src to dest one byte at a time. */
-UTF_API int utf_utfsnrtombs(char* dest, const utf_rune* src, size_t n);
-
+UTF_API int utf_encoderune(char* restrict dest, utf_rune* restrict src);
+
+/* The bytes of a single encoded rune, returned by value. */
+typedef struct utf_encoded_s {
+    char bytes[UTF_BYTES_MAX];
+    int len;
+    int error;
+} utf_encoded_s;
+
+/* Identical to utf_encoderune(), except that the encoded bytes, their length
+and the error code are returned by value. No state is allocated and utf_errno is
+not touched. */
+UTF_API utf_encoded_s utf_encoderune_v(utf_rune r);
+
+/* Encode the null-terminated rune string at *src into at most len bytes at
+dest, followed by a null byte if there is room for it. Runes are never split
+when dest is full. *src is advanced past the runes consumed, so it points at the
+null rune when the whole string was encoded. Return the number of bytes written,
+not counting the null byte. If a rune cannot be encoded, because it is a
+surrogate, a non-character or out of range, encoding stops in front of it and
+utf_errno is set. If dest is a null pointer, nothing is written and len is
+ignored. */
+UTF_API size_t utf_utfsrtombs(char* dest, const utf_rune** src, size_t len);
+
+/* Identical to utf_utfsrtombs(), except that exactly n runes are encoded from
+*src, null runes included, and no null byte is appended. */
+UTF_API size_t utf_utfsnrtombs(char* dest, const utf_rune** src, size_t n,
+                               size_t len);
+
+
+/* Return the number of bytes utf_utfsnrtombs() writes when it encodes the n
+runes at s into a buffer that is large enough, so that the buffer can be sized
+exactly up front. Counting stops in front of a rune that cannot be encoded, and
+utf_errno is set as utf_utfsnrtombs() sets it. */
+UTF_API size_t utf_utf8len(const utf_rune* s, size_t n);
+
+/* Return the number of UTF-16 code units needed for the n runes at s, which is
+n plus one for every rune above U+FFFF. s is not validated. */
+UTF_API size_t utf_utf16len_runes(const utf_rune* s, size_t n);
 
 /*
  * Decoding functions
  */
 
 /* Convert a single word to its corresponding UTF rune. */
-UTF_API int utf_decoderune_r(utf_rune* dest restrict, char* src restrict,
+UTF_API int utf_decoderune_r(utf_rune* restrict dest, char* restrict src,
                              int len, utf_state_p state);
-UTF_API int utf_decoderune(utf_rune* dest restrict, char* src restrict,
+UTF_API int utf_decoderune(utf_rune* restrict dest, char* restrict src,
                            int len);
 
-/* Copy from src to dest one rune at a time. */
-UTF_API int utf_mbsrtoufs(utf_rune* dest, const char* src);
+/* Decode the in_len bytes at in, which may begin and end in the middle of a
+rune, into at most out_cap runes in out. A rune cut off at the end of in is kept
+in state and finished from the start of the next buffer, so a stream can be
+decoded one buffer at a time; utf_state_bytes_processed() is then non-zero until
+it is complete. The number of bytes consumed and runes written are stored in
+*consumed and *produced. Decoding stops in front of a malformed sequence, or
+after the part of it in in if it began in an earlier buffer. Its error is then
+returned and stored in state, and otherwise UTF_SUCCESS is returned. If out is a
+null pointer, runes are only counted and out_cap is ignored. */
+UTF_API int utf_decode_stream_r(utf_state_p state, const char* in,
+                                size_t in_len, utf_rune* out, size_t out_cap,
+                                size_t* consumed, size_t* produced);
+
+/* A single decoded rune and the number of bytes it was decoded from, returned
+by value. */
+typedef struct utf_decoded_s {
+    utf_rune rune;
+    int len;
+    int error;
+} utf_decoded_s;
+
+/* Decode the rune at the start of the len bytes at src and return it by value,
+along with its length and the error code. The rune is 0 on error, and len is
+then the number of bytes to skip before decoding again. Decoding is done by
+utf_decode_dfa_r(), without allocating a state or touching utf_errno. */
+UTF_API utf_decoded_s utf_decoderune_v(const char* src, int len);
+
+/* Identical to utf_decoderune_r(), except that the rune is decoded by a
+table-driven state machine with one transition per byte. Byte order marks get no
+special treatment and null bytes decode to a null rune. If the len bytes end in
+the middle of a rune, they are all consumed, UTF_ETRUNC is set and the rune is
+kept in state, so that the next call finishes it from the following bytes.
+Otherwise, the return value is the length of the rune, or of the invalid
+sequence to skip before decoding again, which may be 0 if a sequence kept from
+an earlier call was found to be invalid. */
+UTF_API int utf_decode_dfa_r(utf_rune* restrict dest, char* restrict src,
+                             int len, utf_state_p state);
+
+/* Decode the null-terminated string at *src into at most len runes in dest,
+followed by a null rune if there is room for it. *src is advanced past the bytes
+consumed, so it points at the terminating null byte when the whole string was
+decoded. Return the number of runes written, not counting the null rune. If a
+malformed sequence is found, decoding stops in front of it and utf_errno is
+set. If dest is a null pointer, nothing is written and len is ignored. */
+UTF_API size_t utf_mbsrtoufs(utf_rune* dest, const char** src, size_t len);
+
+/* Identical to utf_mbsrtoufs(), except that exactly n bytes are decoded from
+*src, null bytes included, and no null rune is appended. */
+UTF_API size_t utf_mbsnrtoufs(utf_rune* dest, const char** src, size_t n,
+                              size_t len);
+
+/* Identical to utf_mbsnrtoufs(), except that a large input is split at rune
+boundaries into chunks that are decoded in parallel by up to threads threads,
+as utf_validate_mt() does. */
+UTF_API size_t utf_mbsnrtoufs_mt(utf_rune* dest, const char** src, size_t n,
+                                 size_t len, int threads);
+
+/* Identical to utf_mbsnrtoufs(), except that each maximal invalid subpart of
+the input, and each non-character, is replaced with a single
+UTF_REPLACEMENT_CHAR and decoding carries on after it. utf_errno is set to the
+error of the first sequence replaced, or UTF_SUCCESS if there was none. */
+UTF_API size_t utf_mbsnrtoufs_lossy(utf_rune* dest, const char** src, size_t n,
+                                    size_t len);
+
+/* Copy the n bytes at *src to at most len bytes at dest, replacing malformed
+sequences with UTF_REPLACEMENT_CHAR as utf_mbsnrtoufs_lossy() does, so that
+dest holds valid UTF-8. *src is advanced past the bytes consumed, and the number
+of bytes written is returned. Runes are never split when dest is full. If dest
+is a null pointer, nothing is written and len is ignored. The buffers must not
+overlap. */
+UTF_API size_t utf_mbsnrsanitize(char* dest, const char** src, size_t n,
+                                 size_t len);
+
+
+/*
+ * Encodings
+ */
+
+/* Encodings shared by the UTF-16 functions, the views and the file functions.
+Each of those says which of them it accepts. UTF-32 is a sequence of runes in
+native byte order. UTF-16 code units are stored in the byte order given,
+whatever the byte order of the machine. */
+#define UTF_ENCODING_UTF8    0
+#define UTF_ENCODING_UTF32   1
+#define UTF_ENCODING_UTF16LE 2
+#define UTF_ENCODING_UTF16BE 3
+#define UTF_ENCODING_LATIN1  4
+#define UTF_ENCODING_CESU8   5
+#define UTF_ENCODING_MUTF8   6
 
-/* Copy up to n runes from src to dest one rune at a time. */
-UTF_API int utf_mbsnrtoufs(utf_rune* dest, const char* src, size_t n);
+
+/*
+ * UTF-16 functions
+ */
+
+/* Convert the n bytes of UTF-8 at *src to at most len UTF-16 code units in
+dest, stored in the byte order of encoding, which is either
+UTF_ENCODING_UTF16LE or UTF_ENCODING_UTF16BE; with any other encoding, nothing
+is converted and utf_errno is set to UTF_EVALUE. Runes above U+FFFF become
+surrogate pairs, which are never split when dest is full. *src is advanced past
+the bytes consumed, and the number of code units written is returned. If a
+malformed sequence is found, conversion stops in front of it and utf_errno is
+set. If dest is a null pointer, nothing is written and len is ignored. */
+UTF_API size_t utf_mbsnrtoutf16(utf_char16* dest, const char** src, size_t n,
+                                size_t len, int encoding);
+
+/* Convert the n UTF-16 code units at *src, stored in the byte order of
+encoding as for utf_mbsnrtoutf16(), to at most len bytes of UTF-8 at dest.
+Runes are never split when dest is full. *src is advanced past the code units
+consumed, and the number of bytes written is returned. Conversion stops in front
+of an unpaired surrogate or a non-character, with utf_errno set to UTF_ESEQ, or
+in front of a high surrogate that ends the input, with utf_errno set to
+UTF_ETRUNC. If dest is a null pointer, nothing is written and len is ignored. */
+UTF_API size_t utf_utf16snrtombs(char* dest, const utf_char16** src, size_t n,
+                                 size_t len, int encoding);
+
+
+/*
+ * Latin-1 functions
+ */
+
+/* Convert the n bytes of ISO-8859-1 at *src to at most len bytes of UTF-8 at
+dest. Every byte is a valid rune, and those above 0x7F take up two bytes, which
+are never split when dest is full. *src is advanced past the bytes consumed, and
+the number of bytes written is returned. If dest is a null pointer, nothing is
+written and len is ignored. */
+UTF_API size_t utf_latin1_to_utf8(char* dest, const char** src, size_t n,
+                                  size_t len);
+
+/* Convert the n bytes of UTF-8 at *src to at most len bytes of ISO-8859-1 at
+dest. *src is advanced past the bytes consumed, and the number of bytes written
+is returned. If a malformed sequence is found, conversion stops in front of it
+and utf_errno is set as by utf_mbsnrtoufs(). If a rune above U+00FF is found,
+conversion stops in front of it, so that *src points at the first rune that
+cannot be represented, and utf_errno is set to UTF_ERANGE. If dest is a null
+pointer, nothing is written and len is ignored. */
+UTF_API size_t utf_utf8_to_latin1(char* dest, const char** src, size_t n,
+                                  size_t len);
+
+
+/*
+ * CESU-8 and Modified UTF-8 functions
+ */
+
+/* Convert the n bytes of CESU-8 at *src to at most len bytes of UTF-8 at dest.
+CESU-8 encodes runes up to U+FFFF as UTF-8 does, and runes above U+FFFF as a
+surrogate pair of three-byte sequences, which becomes a single four-byte
+sequence. Runes are never split when dest is full. *src is advanced past the
+bytes consumed, and the number of bytes written is returned. If a malformed
+sequence, an unpaired surrogate or a four-byte sequence is found, conversion
+stops in front of it and utf_errno is set. If dest is a null pointer, nothing is
+written and len is ignored. */
+UTF_API size_t utf_cesu8_to_utf8(char* dest, const char** src, size_t n,
+                                 size_t len);
+
+/* Convert the n bytes of UTF-8 at *src to at most len bytes of CESU-8 at dest,
+as utf_cesu8_to_utf8() does in the other direction. Runes above U+FFFF take up
+six bytes. */
+UTF_API size_t utf_utf8_to_cesu8(char* dest, const char** src, size_t n,
+                                 size_t len);
+
+/* Convert the n bytes of Modified UTF-8, as used by Java and JNI, at *src to at
+most len bytes of UTF-8 at dest, as utf_cesu8_to_utf8() does. Modified UTF-8 is
+CESU-8 with the null rune encoded as C0 80, which becomes a null byte; a null
+byte in the input is accepted as well. */
+UTF_API size_t utf_mutf8_to_utf8(char* dest, const char** src, size_t n,
+                                 size_t len);
+
+/* Convert the n bytes of UTF-8 at *src to at most len bytes of Modified UTF-8
+at dest, as utf_utf8_to_cesu8() does, encoding null bytes as C0 80 so that the
+output contains none. */
+UTF_API size_t utf_utf8_to_mutf8(char* dest, const char** src, size_t n,
+                                 size_t len);
+
+
+/*
+ * View functions
+ */
+
+/* Bytes converted by utf_convert_view(), either borrowed from the input or held
+in a buffer of their own. */
+typedef struct utf_view_s {
+    const char* data;           /* The converted bytes. */
+    size_t len;                 /* Number of bytes at data. */
+    size_t consumed;            /* Number of input bytes converted. */
+    char* owned;                /* Buffer holding data, or null if borrowed. */
+    utf_allocator_s allocator;  /* Allocator that allocated owned. */
+} utf_view_s;
+
+/* Convert the n bytes at s from the encoding from to the encoding to and fill
+in view. One of them must be UTF_ENCODING_UTF8 and the other UTF_ENCODING_UTF8,
+UTF_ENCODING_LATIN1, UTF_ENCODING_CESU8 or UTF_ENCODING_MUTF8; from UTF-8 to
+UTF-8, malformed sequences are replaced as utf_mbsnrsanitize() does. The input
+is scanned first, and as long as it needs no change, as pure ASCII needs none in
+any of these conversions, view->data points into s and nothing is copied.
+Otherwise a buffer of the exact size is allocated, the unchanged prefix is
+copied into it, and conversion starts at the first byte that needs it. The
+conversion stops and sets utf_errno as the function for the encodings does, and
+view->consumed tells how far it got. Return 0, or -1 with errno set if the
+conversion is not supported or the buffer could not be allocated. The view must
+be released with utf_view_release(). */
+UTF_API int utf_convert_view(const char* s, size_t n, int from, int to,
+                             utf_view_s* view);
+
+/* Identical to utf_convert_view(), except that the buffer is allocated with
+allocator, or with the default allocator if it is a null pointer. */
+UTF_API int utf_convert_view_with(const char* s, size_t n, int from, int to,
+                                  utf_view_s* view,
+                                  const utf_allocator_s* allocator);
+
+/* Free the buffer owned by view, if any, with the allocator that allocated it,
+and clear the view. */
+UTF_API void utf_view_release(utf_view_s* view);
+
+/*
+ * File functions
+ */
+
+/* Validate the contents of the file at path, as utf_validate_ex() does, and
+fill in result. The file is memory-mapped and read in place, so it must be a
+regular file. Return 0, or -1 with errno set if the file could not be read or
+is not a regular file (EINVAL). */
+UTF_API int utf_validate_file(const char* path, utf_validation_s* result);
+
+/* Transcode the contents of the file at src_path from the encoding from to the
+encoding to, and write them to the file at dst_path, which is created or
+truncated. The source file is memory-mapped and read in place, so it must be a
+regular file. Conversion stops at the first malformed sequence, and its UTF_E*
+code is returned after the output up to it has been written. Return UTF_SUCCESS
+if the whole file was transcoded, or -1 with errno set if either file could not
+be accessed, the source is not a regular file (EINVAL) or the conversion is not
+supported. UTF-8 can be converted to any encoding, and UTF-16, Latin-1, CESU-8
+and Modified UTF-8 can be converted to UTF-8. */
+UTF_API int utf_transcode_file(const char* src_path, const char* dst_path,
+                               int from, int to);
 
 
 /*
  * Transformation functions
  */
 
-/* If r is a letter, return its lower-case version, if one exists. */
+/* Return the simple lower-case mapping of r given by the UCD, or r itself if it
+has none. */
 UTF_API utf_rune utf_tolower(utf_rune r);
 
-/* If r is a letter, return its upper-case version, if one exists. */
+/* Return the simple upper-case mapping of r given by the UCD, or r itself if it
+has none. */
 UTF_API utf_rune utf_toupper(utf_rune r);
 
-/* If r is a letter, return its title-case version, if one exists. */
+/* Return the simple title-case mapping of r given by the UCD, or r itself if it
+has none. */
 UTF_API utf_rune utf_totitle(utf_rune r);
 
 /* Return whether r is a numeric rune with a value. */
@@ -288,9 +717,15 @@ UTF_API utf_rune* utf_strrchr(const utf_rune* s, utf_rune r);
 /* Return a pointer to the last occurrence of r in s, up to n runes. */
 UTF_API utf_rune* utf_strnrchr(const utf_rune* s, utf_rune r, size_t n);
 
-/* Return a new copy of s. */
+/* Return a new copy of s, or a null pointer if it could not be allocated. The
+copy is allocated with the default allocator, which must be used to free it. */
 UTF_API utf_rune* utf_strdup(const utf_rune* s);
 
+/* Identical to utf_strdup(), except that the copy is allocated with allocator,
+or with the default allocator if it is a null pointer. */
+UTF_API utf_rune* utf_strdup_with(const utf_rune* s,
+                                  const utf_allocator_s* allocator);
+
 /* Find the first occurrence of the entire string s2 in s1, not including the
 terminating null character, and return a pointer to the start of the substring
 in s1. */
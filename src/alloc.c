@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <utf/utf.h>
+
+#include "alloc.h"
+
+static void* utf_std_alloc(void* user, size_t size)
+{
+    (void)user;
+    return malloc(size);
+}
+
+static void utf_std_free(void* user, void* p, size_t size)
+{
+    (void)user;
+    (void)size;
+    free(p);
+}
+
+static const utf_allocator_s utf_std_allocator = {
+    utf_std_alloc, utf_std_free, 0
+};
+
+static utf_allocator_s utf_default_allocator = {
+    utf_std_alloc, utf_std_free, 0
+};
+
+void utf_set_allocator(const utf_allocator_s* allocator)
+{
+    utf_default_allocator = allocator ? *allocator : utf_std_allocator;
+}
+
+const utf_allocator_s* utf_get_allocator(void)
+{
+    return &utf_default_allocator;
+}
+
+const utf_allocator_s* utf_allocator(const utf_allocator_s* allocator)
+{
+    return allocator ? allocator : &utf_default_allocator;
+}
+
+void* utf_alloc(const utf_allocator_s* allocator, size_t size)
+{
+    /* Zero-sized blocks are not portable, so every block has a byte. */
+    return allocator->alloc(allocator->user, size ? size : 1);
+}
+
+void utf_free(const utf_allocator_s* allocator, void* p, size_t size)
+{
+    if (p) {
+        allocator->free(allocator->user, p, size ? size : 1);
+    }
+}
+
+utf_rune* utf_strdup(const utf_rune* s)
+{
+    return utf_strdup_with(s, 0);
+}
+
+utf_rune* utf_strdup_with(const utf_rune* s, const utf_allocator_s* allocator)
+{
+    utf_rune* copy;
+    size_t n = 0;
+
+    if (!s) {
+        return 0;
+    }
+
+    while (s[n]) {
+        n++;
+    }
+
+    copy = (utf_rune*)utf_alloc(utf_allocator(allocator),
+                                (n + 1) * sizeof(utf_rune));
+    if (copy) {
+        memcpy(copy, s, (n + 1) * sizeof(utf_rune));
+    }
+
+    return copy;
+}
@@ -0,0 +1,44 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_ALLOC_H
+#define UTF_ALLOC_H
+
+#include <stddef.h>
+
+#include <utf/utf.h>
+
+/* Return allocator, or the default allocator if it is a null pointer. */
+const utf_allocator_s* utf_allocator(const utf_allocator_s* allocator);
+
+/* Allocate and free size bytes with allocator, which must not be a null
+ * pointer.
+ */
+void* utf_alloc(const utf_allocator_s* allocator, size_t size);
+void utf_free(const utf_allocator_s* allocator, void* p, size_t size);
+
+#endif /* UTF_ALLOC_H */
@@ -68,3 +68,11 @@ static int utf_count_leading_zeros(unsigned int x)
     return (int)(clz_lookup[x >> n] - n);
 }
 
+int utf_count_ones(unsigned int x)
+{
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;
+
+    return (int)((x * 0x01010101U) >> 24);
+}
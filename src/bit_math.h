@@ -28,8 +28,14 @@ SPDX-License-Identifier: MIT
 #ifndef BIT_MATH_H
 #define BIT_MATH_H
 
-#if defined(__BMI__) || defined(_MSC_VER)
-#  define utf_clz(x) __lzcnt((x))
+/* LZCNT is its own extension, not part of BMI1, and only the intrinsics header
+ * declares it. */
+#if defined(__LZCNT__)
+#  include <immintrin.h>
+#  define utf_clz(x) ((int)_lzcnt_u32((x)))
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define utf_clz(x) ((int)__lzcnt((x)))
 #elif defined(__GNUC__) || defined(__clang__)
 #  if __has_builtin(__builtin_clz)
 #    define utf_clz(x) __builtin_clz((x))
@@ -38,6 +44,18 @@ SPDX-License-Identifier: MIT
 #  endif
 #endif
 
+#if defined(__POPCNT__) || defined(__GNUC__) || defined(__clang__)
+#  if __has_builtin(__builtin_popcount)
+#    define utf_popcount(x) __builtin_popcount((x))
+#  else
+#    define utf_popcount(x) utf_count_ones((x))
+#  endif
+#else
+#  define utf_popcount(x) utf_count_ones((x))
+#endif
+
 static int utf_count_leading_zeros(unsigned int x);
 
+int utf_count_ones(unsigned int x);
+
 #endif /* BIT_MATH_H */
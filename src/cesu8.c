@@ -0,0 +1,345 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "bit_math.h"
+#include "error.h"
+#include "simd.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Input is validated this many bytes at a time before it is converted, as in
+ * transcode.c. */
+#define UTF_CHUNK_SIZE 4096
+
+/* CESU-8 and Modified UTF-8 encode every rune of the BMP exactly as UTF-8
+ * does, so most of the input is validated and copied through unchanged. Only
+ * supplementary runes, which they encode as a surrogate pair of three-byte
+ * sequences, and, in Modified UTF-8, the null rune, which it encodes as the
+ * overlong C0 80, have to be converted.
+ */
+
+/* Return the offset of the first byte from i up to end that starts a four-byte
+ * sequence, or that is a null byte if nul is set, or end if there is none.
+ */
+static size_t utf_cesu8_span(const unsigned char* s, size_t i, size_t end,
+                             int nul)
+{
+#if defined(UTF_SIMD_WIDTH)
+    __m128i zero = _mm_setzero_si128();
+    __m128i v, hit;
+    unsigned int mask;
+
+    for (; end - i >= 16; i += 16) {
+        v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+
+        /* Bytes from F0 up are the negative bytes above EF. */
+        hit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)0xEF)),
+                            _mm_cmplt_epi8(v, zero));
+        if (nul) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, zero));
+        }
+
+        mask = (unsigned int)_mm_movemask_epi8(hit);
+        if (mask) {
+            return i + (size_t)utf_popcount((mask & (0U - mask)) - 1);
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        if (s[i] >= 0xF0 || (nul && !s[i])) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* Copy the runes in s from *pos up to end to at most cap bytes at dest, or just
+ * count them if dest is a null pointer, and advance *pos past them. Runes are
+ * never split. Return the number of bytes copied.
+ */
+static size_t utf_cesu8_copy(const unsigned char* s, size_t* pos, size_t end,
+                             unsigned char* dest, size_t cap)
+{
+    size_t n = end - *pos;
+
+    if (dest) {
+        if (n > cap) {
+            n = cap;
+            while (n > 0 && utf_utf8_is_cont(s[*pos + n])) {
+                n--;
+            }
+        }
+
+        memcpy(dest, s + *pos, n);
+    }
+
+    *pos += n;
+    return n;
+}
+
+/* Check the surrogate pair that should start at s, which has avail bytes left,
+ * and store the rune it encodes in *r. Return UTF_SUCCESS, UTF_ETRUNC if the
+ * pair is cut short, or UTF_ESEQ.
+ */
+static int utf_cesu8_pair(const unsigned char* s, size_t avail, utf_rune* r)
+{
+    static const unsigned char lo[6] = { 0xED, 0xA0, 0x80, 0xED, 0xB0, 0x80 };
+    static const unsigned char hi[6] = { 0xED, 0xAF, 0xBF, 0xED, 0xBF, 0xBF };
+    size_t i;
+
+    for (i = 0; i < 6; i++) {
+        if (i >= avail) {
+            return UTF_ETRUNC;
+        }
+
+        if (s[i] < lo[i] || s[i] > hi[i]) {
+            return UTF_ESEQ;
+        }
+    }
+
+    *r = 0x10000 + ((utf_rune)(s[1] & 0x0F) << 16 |
+                    (utf_rune)(s[2] & 0x3F) << 10 |
+                    (utf_rune)(s[4] & 0x0F) << 6 |
+                    (utf_rune)(s[5] & 0x3F));
+
+    return utf_utf8_check_rune(*r);
+}
+
+/* Convert the n bytes of CESU-8, or of Modified UTF-8 if mutf8 is set, in s
+ * from *pos to at most len bytes of UTF-8 at dest, or just count them if dest
+ * is a null pointer, and advance *pos past the bytes consumed. Conversion stops
+ * in front of the first malformed sequence, whose error is stored in *error.
+ * Return the number of bytes written.
+ */
+static size_t utf_cesu8_decode(const unsigned char* s, size_t* pos, size_t n,
+                               unsigned char* dest, size_t len, int mutf8,
+                               int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t valid, stop, end;
+    utf_rune r;
+
+    *error = UTF_SUCCESS;
+
+    while (i < n) {
+        end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+        valid = i + utf_validate_prefix((const char*)s + i, end - i, error);
+
+        if (*error == UTF_ETRUNC && end < n) {
+            /* Only the chunk was cut short, so the next one picks it up. */
+            *error = UTF_SUCCESS;
+        }
+
+        /* Supplementary runes must come as surrogate pairs. */
+        stop = utf_cesu8_span(s, i, valid, 0);
+        if (stop < valid) {
+            valid = stop;
+            *error = UTF_ESEQ;
+        }
+
+        out += utf_cesu8_copy(s, &i, valid, dest ? dest + out : 0, len - out);
+        if (i < valid) {
+            *error = UTF_SUCCESS;
+            break;
+        }
+
+        if (*error == UTF_SUCCESS) {
+            continue;
+        }
+
+        if (mutf8 && s[i] == 0xC0 && n - i >= 2 && s[i + 1] == 0x80) {
+            if (dest) {
+                if (out >= len) {
+                    *error = UTF_SUCCESS;
+                    break;
+                }
+                dest[out] = 0;
+            }
+            out++;
+            i += 2;
+            *error = UTF_SUCCESS;
+            continue;
+        }
+
+        if (s[i] == 0xED && n - i >= 2 && s[i + 1] >= 0xA0) {
+            *error = utf_cesu8_pair(s + i, n - i, &r);
+            if (*error != UTF_SUCCESS) {
+                break;
+            }
+
+            if (dest) {
+                if (len - out < 4) {
+                    break;
+                }
+                utf_utf8_encode(r, dest + out);
+            }
+            out += 4;
+            i += 6;
+            continue;
+        }
+
+        break;
+    }
+
+    *pos = i;
+    return out;
+}
+
+/* Convert the n bytes of UTF-8 in s from *pos to at most len bytes of CESU-8,
+ * or of Modified UTF-8 if mutf8 is set, at dest, as utf_cesu8_decode() does in
+ * the other direction.
+ */
+static size_t utf_cesu8_encode(const unsigned char* s, size_t* pos, size_t n,
+                               unsigned char* dest, size_t len, int mutf8,
+                               int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t valid, stop, end, k;
+    utf_rune r;
+
+    *error = UTF_SUCCESS;
+
+    while (i < n) {
+        end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+        valid = i + utf_validate_prefix((const char*)s + i, end - i, error);
+
+        if (*error == UTF_ETRUNC && end < n) {
+            /* Only the chunk was cut short, so the next one picks it up. */
+            *error = UTF_SUCCESS;
+        }
+
+        while (i < valid) {
+            stop = utf_cesu8_span(s, i, valid, mutf8);
+            out += utf_cesu8_copy(s, &i, stop, dest ? dest + out : 0,
+                                  len - out);
+            if (i < stop) {
+                *error = UTF_SUCCESS;
+                *pos = i;
+                return out;
+            }
+
+            if (i == valid) {
+                break;
+            }
+
+            if (!s[i]) {
+                if (dest) {
+                    if (len - out < 2) {
+                        *error = UTF_SUCCESS;
+                        *pos = i;
+                        return out;
+                    }
+                    dest[out] = 0xC0;
+                    dest[out + 1] = 0x80;
+                }
+                out += 2;
+                i++;
+                continue;
+            }
+
+            r = utf_utf8_decode(s + i, &k) - 0x10000;
+
+            if (dest) {
+                if (len - out < 6) {
+                    *error = UTF_SUCCESS;
+                    *pos = i;
+                    return out;
+                }
+                dest[out] = 0xED;
+                dest[out + 1] = (unsigned char)(0xA0 | (r >> 16));
+                dest[out + 2] = (unsigned char)(0x80 | ((r >> 10) & 0x3F));
+                dest[out + 3] = 0xED;
+                dest[out + 4] = (unsigned char)(0xB0 | ((r >> 6) & 0x0F));
+                dest[out + 5] = (unsigned char)(0x80 | (r & 0x3F));
+            }
+            out += 6;
+            i += k;
+        }
+
+        if (*error != UTF_SUCCESS) {
+            break;
+        }
+    }
+
+    *pos = i;
+    return out;
+}
+
+/* Run convert over the n bytes at *src, as the public functions below do. */
+static size_t utf_cesu8_run(size_t (*convert)(const unsigned char*, size_t*,
+                                              size_t, unsigned char*, size_t,
+                                              int, int*),
+                            char* dest, const char** src, size_t n, size_t len,
+                            int mutf8)
+{
+    size_t i = 0;
+    size_t out;
+    int error;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    out = convert((const unsigned char*)*src, &i, n, (unsigned char*)dest,
+                  len, mutf8, &error);
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
+
+size_t utf_cesu8_to_utf8(char* dest, const char** src, size_t n, size_t len)
+{
+    return utf_cesu8_run(utf_cesu8_decode, dest, src, n, len, 0);
+}
+
+size_t utf_mutf8_to_utf8(char* dest, const char** src, size_t n, size_t len)
+{
+    return utf_cesu8_run(utf_cesu8_decode, dest, src, n, len, 1);
+}
+
+size_t utf_utf8_to_cesu8(char* dest, const char** src, size_t n, size_t len)
+{
+    return utf_cesu8_run(utf_cesu8_encode, dest, src, n, len, 0);
+}
+
+size_t utf_utf8_to_mutf8(char* dest, const char** src, size_t n, size_t len)
+{
+    return utf_cesu8_run(utf_cesu8_encode, dest, src, n, len, 1);
+}
@@ -0,0 +1,297 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "bit_math.h"
+#include "error.h"
+#include "simd.h"
+#include "transcode.h"
+#include "ucd.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Input is validated this many bytes at a time before it is classified, as in
+ * transcode.c. */
+#define UTF_CHUNK_SIZE 4096
+
+/* Runes that are not ASCII are decoded into a buffer of this many runes, and
+ * classified from there. */
+#define UTF_CLASSIFY_BATCH 128
+
+/* Store the properties of the ASCII bytes at the start of the n bytes at s in
+ * dest, and return how many there were. */
+static size_t utf_classify_ascii(const unsigned char* s, size_t n,
+                                 uint_least32_t* dest)
+{
+    size_t i = 0;
+    size_t k;
+
+#if defined(UTF_SIMD_WIDTH)
+    while (n - i >= UTF_SIMD_WIDTH && !utf_vec_mask(utf_vec_load(s + i))) {
+        for (k = 0; k < UTF_SIMD_WIDTH; k++) {
+            dest[i + k] = utf_ucd_latin1[s[i + k]] & UTF_UCD_CLASS_MASK;
+        }
+
+        i += UTF_SIMD_WIDTH;
+    }
+#endif
+
+    for (k = i; k < n && s[k] < 0x80; k++) {
+        dest[k] = utf_ucd_latin1[s[k]] & UTF_UCD_CLASS_MASK;
+    }
+
+    return k;
+}
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* The bit for each high nibble of an ASCII byte in the bitmaps built by
+ * utf_class_scan(). Bytes above 0x7F have none. */
+static const unsigned char utf_class_nibble_bits[16] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* Return the mask of the bytes of v at which utf_class_scan() must stop: every
+ * byte above 0x7F, and the ASCII bytes for which the bitmap test gives want.
+ * table is the bitmap, indexed by the low nibble of a byte, with the bit for
+ * its high nibble set if the byte is in the class.
+ */
+static inline unsigned int utf_class_stops(utf_vec v, utf_vec table,
+                                           utf_vec bits, bool want)
+{
+    utf_vec low = utf_vec_set1(0x0F);
+    utf_vec hit = utf_vec_and(utf_vec_lookup(table, utf_vec_and(v, low)),
+        utf_vec_lookup(bits, utf_vec_and(utf_vec_shr4(v), low)));
+    unsigned int miss = utf_vec_mask(utf_vec_eq(hit, utf_vec_zero()));
+
+    if (want) {
+        return (~miss & (0xFFFFFFFFU >> (32 - UTF_SIMD_WIDTH))) |
+            utf_vec_mask(v);
+    }
+
+    return miss;
+}
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+/* Return the offset of the first rune in the len bytes at s for which whether
+ * it is in any of the classes in mask is want, or len if there is none. If a
+ * malformed sequence comes first, return its offset and store its UTF_E* code
+ * in *error. ASCII is tested a vector at a time against a bitmap of the ASCII
+ * bytes in the classes, and only the other runes are decoded and looked up.
+ */
+static size_t utf_class_scan(const unsigned char* s, size_t len,
+                             uint_least32_t mask, bool want, int* error)
+{
+    uint_least32_t properties;
+    utf_rune r;
+    size_t i = 0;
+    size_t n;
+#if defined(UTF_SIMD_LOOKUP)
+    unsigned char bitmap[16];
+    utf_vec table = utf_vec_zero();
+    utf_vec bits = utf_vec_zero();
+    unsigned int stops;
+    unsigned int c;
+
+    /* Only worth building if there is a vector's worth to test. */
+    if (len >= 32) {
+        memset(bitmap, 0, sizeof(bitmap));
+
+        for (c = 0; c < 0x80; c++) {
+            if (utf_ucd_latin1[c] & mask) {
+                bitmap[c & 0x0F] |= (unsigned char)(1U << (c >> 4));
+            }
+        }
+
+        table = utf_vec_table(bitmap);
+        bits = utf_vec_table(utf_class_nibble_bits);
+    }
+#endif
+
+    *error = UTF_SUCCESS;
+
+    while (i < len) {
+#if defined(UTF_SIMD_LOOKUP)
+        while (len - i >= 32) {
+#  if UTF_SIMD_WIDTH == 16
+            stops = utf_class_stops(utf_vec_load(s + i), table, bits, want) |
+                utf_class_stops(utf_vec_load(s + i + 16), table, bits, want)
+                    << 16;
+#  else
+            stops = utf_class_stops(utf_vec_load(s + i), table, bits, want);
+#  endif
+
+            if (stops) {
+                i += (size_t)utf_popcount((stops & (0U - stops)) - 1);
+                break;
+            }
+
+            i += 32;
+        }
+
+        if (i >= len) {
+            break;
+        }
+#endif
+
+        if (utf_utf8_is_ascii(s[i])) {
+            properties = utf_ucd_latin1[s[i]];
+            n = 1;
+        } else {
+            *error = utf_utf8_check(s + i, len - i, &n);
+
+            if (*error != UTF_SUCCESS) {
+                return i;
+            }
+
+            r = utf_utf8_decode(s + i, &n);
+            properties = utf_ucd_lookup(r);
+        }
+
+        if (((properties & mask) != 0) == want) {
+            return i;
+        }
+
+        i += n;
+    }
+
+    return len;
+}
+
+bool utf_find_class(const char* s, size_t len, uint_least32_t class_mask,
+                    size_t* offset)
+{
+    int error;
+
+    if (!s) {
+        *offset = 0;
+        utf_set_error(UTF_SUCCESS);
+        return false;
+    }
+
+    *offset = utf_class_scan((const unsigned char*)s, len,
+                             class_mask & UTF_UCD_CLASS_MASK, true, &error);
+    utf_set_error(error);
+    return *offset < len && error == UTF_SUCCESS;
+}
+
+size_t utf_span_class(const char* s, size_t len, uint_least32_t class_mask)
+{
+    size_t span;
+    int error;
+
+    if (!s) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    span = utf_class_scan((const unsigned char*)s, len,
+                          class_mask & UTF_UCD_CLASS_MASK, false, &error);
+    utf_set_error(error);
+    return span;
+}
+
+void utf_classify_n(const utf_rune* runes, size_t n, uint_least32_t* flags)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        flags[i] = utf_ucd_lookup(runes[i]) & UTF_UCD_CLASS_MASK;
+    }
+}
+
+size_t utf_mbsnrclassify(uint_least32_t* dest, const char** src, size_t n,
+                         size_t len)
+{
+    utf_rune runes[UTF_CLASSIFY_BATCH];
+    const unsigned char* s;
+    size_t i = 0;
+    size_t out = 0;
+    size_t valid = 0;
+    size_t end;
+    size_t count;
+    int error = UTF_SUCCESS;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    if (!dest) {
+        return utf_mbsnrtoufs(0, src, n, 0);
+    }
+
+    s = (const unsigned char*)*src;
+
+    while (i < n && out < len) {
+        if (i == valid) {
+            if (error != UTF_SUCCESS) {
+                break;
+            }
+
+            end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+            valid = i + utf_validate_prefix((const char*)s + i, end - i,
+                                            &error);
+
+            if (error == UTF_ETRUNC && end < n) {
+                /* Only the chunk was cut short, so the next one picks it up. */
+                error = UTF_SUCCESS;
+            }
+
+            continue;
+        }
+
+        end = (valid - i < len - out) ? valid : i + (len - out);
+        count = utf_classify_ascii(s + i, end - i, dest + out);
+        i += count;
+        out += count;
+
+        if (i < valid && out < len) {
+            count = (len - out < UTF_CLASSIFY_BATCH) ? len - out
+                                                     : UTF_CLASSIFY_BATCH;
+            count = utf_decode_valid(s, &i, valid, runes, count);
+            utf_classify_n(runes, count, dest + out);
+            out += count;
+        }
+    }
+
+    if (i < valid) {
+        /* Stopped early because dest is full. */
+        error = UTF_SUCCESS;
+    }
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
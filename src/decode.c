@@ -35,7 +35,7 @@ SPDX-License-Identifier: MIT
 #include "error.h"
 #include "state.h"
 
-int utf_decoderune_r(utf_rune* dest restrict, char* src restrict, int len, utf_state_p state)
+int utf_decoderune_r(utf_rune* restrict dest, char* restrict src, int len, utf_state_p state)
 {
     unsigned char next_byte;
     int num_bytes;
@@ -274,14 +274,219 @@ DECODE_LOOP_EXIT:
     return i;
 }
 
-int utf_decoderune(utf_rune* dest restrict, char* src restrict, int len)
+int utf_decoderune(utf_rune* restrict dest, char* restrict src, int len)
 {
-    utf_state_p state = utf_state_new();
+    utf_state_s state;
     int bytes_processed = 0;
 
-    bytes_processed = utf_decoderune_r(dest, src, len, state);
-    utf_set_error(state->errno);
-    utf_state_destroy(state);
+    memset(&state, 0, sizeof(state));
+    bytes_processed = utf_decoderune_r(dest, src, len, &state);
+    utf_set_error(state.errno);
 
     return bytes_processed;
 }
+
+/* Byte classes for the decoding DFA. The classes split the continuation bytes
+ * where a second byte is restricted (E0, ED, F0 and F4), and the lead bytes by
+ * sequence length and by the error they produce on their own.
+ */
+#define UTF_DFA_ASCII       0   /* 00..7F */
+#define UTF_DFA_CONT_LOW    1   /* 80..8F */
+#define UTF_DFA_CONT_MID    2   /* 90..9F */
+#define UTF_DFA_CONT_HIGH   3   /* A0..BF */
+#define UTF_DFA_OVERLONG    4   /* C0..C1 */
+#define UTF_DFA_LEAD_2      5   /* C2..DF */
+#define UTF_DFA_LEAD_E0     6   /* E0 */
+#define UTF_DFA_LEAD_3      7   /* E1..EC, EE..EF */
+#define UTF_DFA_LEAD_ED     8   /* ED */
+#define UTF_DFA_LEAD_F0     9   /* F0 */
+#define UTF_DFA_LEAD_4      10  /* F1..F3 */
+#define UTF_DFA_LEAD_F4     11  /* F4 */
+#define UTF_DFA_TOO_LARGE   12  /* F5..FD */
+#define UTF_DFA_INVALID     13  /* FE..FF */
+
+/* DFA states are offsets of their row in the transition table, so the next
+ * state is a single load. Rejecting states have the high bit set and carry
+ * the UTF_E* code in the remaining bits.
+ */
+#define UTF_DFA_ACCEPT      0
+#define UTF_DFA_NEED_1      16
+#define UTF_DFA_NEED_2      32
+#define UTF_DFA_NEED_3      48
+#define UTF_DFA_AFTER_E0    64
+#define UTF_DFA_AFTER_ED    80
+#define UTF_DFA_AFTER_F0    96
+#define UTF_DFA_AFTER_F4    112
+#define UTF_DFA_REJECT      0x80
+
+#define C(n) UTF_DFA_##n
+#define R(e) (UTF_DFA_REJECT | UTF_##e)
+
+static const unsigned char utf_dfa_classes[256] = {
+    /* 00..7F */
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII), C(ASCII),
+    /* 80..BF */
+    C(CONT_LOW), C(CONT_LOW), C(CONT_LOW), C(CONT_LOW),
+    C(CONT_LOW), C(CONT_LOW), C(CONT_LOW), C(CONT_LOW),
+    C(CONT_LOW), C(CONT_LOW), C(CONT_LOW), C(CONT_LOW),
+    C(CONT_LOW), C(CONT_LOW), C(CONT_LOW), C(CONT_LOW),
+    C(CONT_MID), C(CONT_MID), C(CONT_MID), C(CONT_MID),
+    C(CONT_MID), C(CONT_MID), C(CONT_MID), C(CONT_MID),
+    C(CONT_MID), C(CONT_MID), C(CONT_MID), C(CONT_MID),
+    C(CONT_MID), C(CONT_MID), C(CONT_MID), C(CONT_MID),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH), C(CONT_HIGH),
+    /* C0..DF */
+    C(OVERLONG), C(OVERLONG), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    C(LEAD_2), C(LEAD_2), C(LEAD_2), C(LEAD_2),
+    /* E0..EF */
+    C(LEAD_E0), C(LEAD_3), C(LEAD_3), C(LEAD_3),
+    C(LEAD_3), C(LEAD_3), C(LEAD_3), C(LEAD_3),
+    C(LEAD_3), C(LEAD_3), C(LEAD_3), C(LEAD_3),
+    C(LEAD_3), C(LEAD_ED), C(LEAD_3), C(LEAD_3),
+    /* F0..FF */
+    C(LEAD_F0), C(LEAD_4), C(LEAD_4), C(LEAD_4),
+    C(LEAD_F4), C(TOO_LARGE), C(TOO_LARGE), C(TOO_LARGE),
+    C(TOO_LARGE), C(TOO_LARGE), C(TOO_LARGE), C(TOO_LARGE),
+    C(TOO_LARGE), C(TOO_LARGE), C(INVALID), C(INVALID)
+};
+
+/* Payload bits of a lead byte, by class. */
+static const unsigned char utf_dfa_masks[16] = {
+    0x7F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x0F, 0x0F,
+    0x0F, 0x07, 0x07, 0x07, 0x00, 0x00, 0x00, 0x00
+};
+
+/* Every byte that is not a continuation byte ends a partial sequence with
+ * UTF_ESEQ, so only the first four columns differ between the other rows.
+ */
+#define UTF_DFA_ROW(low, mid, high) \
+    R(ESEQ), (low), (mid), (high), R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ), \
+    R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ), R(ESEQ)
+
+static const unsigned char utf_dfa_transitions[128] = {
+    /* UTF_DFA_ACCEPT */
+    C(ACCEPT), R(ESTART), R(ESTART), R(ESTART),
+    R(ELEN), C(NEED_1), C(AFTER_E0), C(NEED_2),
+    C(AFTER_ED), C(AFTER_F0), C(NEED_3), C(AFTER_F4),
+    R(ELIMIT), R(EVALUE), R(EVALUE), R(EVALUE),
+    /* UTF_DFA_NEED_1 */
+    UTF_DFA_ROW(C(ACCEPT), C(ACCEPT), C(ACCEPT)),
+    /* UTF_DFA_NEED_2 */
+    UTF_DFA_ROW(C(NEED_1), C(NEED_1), C(NEED_1)),
+    /* UTF_DFA_NEED_3 */
+    UTF_DFA_ROW(C(NEED_2), C(NEED_2), C(NEED_2)),
+    /* UTF_DFA_AFTER_E0: overlong below A0 */
+    UTF_DFA_ROW(R(ELEN), R(ELEN), C(NEED_1)),
+    /* UTF_DFA_AFTER_ED: surrogates from A0 */
+    UTF_DFA_ROW(C(NEED_1), C(NEED_1), R(ESEQ)),
+    /* UTF_DFA_AFTER_F0: overlong below 90 */
+    UTF_DFA_ROW(R(ELEN), C(NEED_2), C(NEED_2)),
+    /* UTF_DFA_AFTER_F4: above U+10FFFF from 90 */
+    UTF_DFA_ROW(C(NEED_2), R(ELIMIT), R(ELIMIT))
+};
+
+#undef UTF_DFA_ROW
+#undef R
+#undef C
+
+int utf_decode_dfa_r(utf_rune* restrict dest, char* restrict src, int len, utf_state_p state)
+{
+    const unsigned char* s = (const unsigned char*)src;
+    unsigned int dfa, prev, type;
+    utf_rune rune;
+    int i = 0;
+
+    assert(state);
+
+    if (!src) {
+        return 0;
+    }
+
+    state->errno = UTF_SUCCESS;
+
+    if (len <= 0) {
+        state->errno = UTF_ETRUNC;
+        return 0;
+    }
+
+    dfa = state->dfa;
+    rune = state->value.word;
+
+    do {
+        type = utf_dfa_classes[s[i]];
+        rune = (dfa == UTF_DFA_ACCEPT) ? (utf_rune)(s[i] & utf_dfa_masks[type]) :
+            (rune << 6 | (s[i] & 0x3Fu));
+        prev = dfa;
+        dfa = utf_dfa_transitions[dfa + type];
+        i++;
+    } while (dfa - 1 < UTF_DFA_REJECT - 1 && i < len);
+
+    if (dfa == UTF_DFA_ACCEPT) {
+        /* Surrogates never get this far, but non-characters do. */
+        if (rune >= 0xFDD0 && !utf_is_valid_rune(rune)) {
+            state->errno = UTF_ESEQ;
+        } else if (dest) {
+            *dest = rune;
+        }
+    } else if (dfa & UTF_DFA_REJECT) {
+        state->errno = (int)(dfa ^ UTF_DFA_REJECT);
+
+        /* Only an invalid lead byte is part of the rejected sequence. */
+        if (prev != UTF_DFA_ACCEPT) {
+            i--;
+        }
+    } else {
+        /* Keep the partial rune so the next call can finish it. */
+        state->errno = UTF_ETRUNC;
+        state->dfa = dfa;
+        state->value.word = rune;
+        state->count += i;
+        return i;
+    }
+
+    state->dfa = UTF_DFA_ACCEPT;
+    state->value.word = 0;
+    state->count = 0;
+    return i;
+}
+
+utf_decoded_s utf_decoderune_v(const char* src, int len)
+{
+    utf_state_s state;
+    utf_decoded_s result;
+
+    memset(&state, 0, sizeof(state));
+    result.rune = 0;
+    result.len = utf_decode_dfa_r(&result.rune, (char*)src, len, &state);
+    result.error = state.errno;
+
+    return result;
+}
@@ -25,7 +25,6 @@ SPDX-FileCopyrightText: 2020 Ryan Egesdahl
 SPDX-License-Identifier: MIT
 */
 
-#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -34,12 +33,15 @@ SPDX-License-Identifier: MIT
 
 #include "state.h"
 #include "error.h"
+#include "utf8.h"
 
-int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
+int utf_encoderune_r(char* restrict dest, utf_rune* restrict src,
                      utf_state_p state)
 {
+    char scratch[UTF_BYTES_MAX];
     utf_rune temp = 0;
     int n = 0;
+    int rune_len;
 
     assert(state);
     assert(state->count <= 0);
@@ -48,8 +50,9 @@ int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
         return 0;
     }
 
+    /* Without a destination, the rune is only measured. */
     if (!dest) {
-        dest = (char *)calloc(UTF_BYTES_MAX, sizeof(char));
+        dest = scratch;
     }
 
     if (sizeof(utf_rune) == 2 && state->count == -4 && utf_is_pair_end(*src)) {
@@ -67,21 +70,22 @@ int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
         n = 3;
     }
 
+    rune_len = utf_runelen(*src);
+
     /* BMP rune */
-    if (utf_runelen(*src) == 1) {
+    if (rune_len == 1) {
         *dest = (char)*src;
         return n + 1;
     }
 
     /* 2-byte rune */
-    if (utf_runelen(*src) == 2) {
-        *dest++ = (char)(0xC0 | ((*src & 0x7C0) >> 6));
-        *dest   = (char)(0x80 |  (*src & 0x03F));
+    if (rune_len == 2) {
+        utf_utf8_encode_2(*src, (unsigned char*)dest);
         return n + 2;
     }
 
     /* 3-byte rune */
-    if (utf_runelen(*src) == 3) {
+    if (rune_len == 3) {
         /* Member of a surrogate pair */
         if (sizeof(utf_rune) == 2 && utf_is_pair(*src)) {
 
@@ -117,7 +121,7 @@ int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
         return n + 3;
     }
 
-    if (utf_runelen(*src) == 4) {
+    if (rune_len == 4) {
         *dest++ = (char)(0xF0 | ((*src & 0x1C0000) >> 18));
         *dest++ = (char)(0x80 | ((*src & 0x03F000) >> 12));
         *dest++ = (char)(0x80 | ((*src & 0x000FC0) >> 6));
@@ -129,14 +133,27 @@ int utf_encoderune_r(char* dest restrict, utf_rune* src restrict,
     return 0;
 }
 
-int utf_encoderune(char* dest restrict, utf_rune* src restrict)
+int utf_encoderune(char* restrict dest, utf_rune* restrict src)
 {
-    utf_state_p state = utf_state_new();
+    utf_state_s state;
     int bytes_processed = 0;
 
-    bytes_processed = utf_encoderune_r(dest, src, state);
-    utf_set_error(state->errno);
-    utf_state_destroy(state);
+    memset(&state, 0, sizeof(state));
+    bytes_processed = utf_encoderune_r(dest, src, &state);
+    utf_set_error(state.errno);
 
     return bytes_processed;
 }
+
+utf_encoded_s utf_encoderune_v(utf_rune r)
+{
+    utf_state_s state;
+    utf_encoded_s result;
+
+    memset(&state, 0, sizeof(state));
+    memset(result.bytes, 0, sizeof(result.bytes));
+    result.len = utf_encoderune_r(result.bytes, &r, &state);
+    result.error = state.errno;
+
+    return result;
+}
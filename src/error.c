@@ -45,6 +45,7 @@ const char* utf_error_messages[] = {
     "Overlong byte sequence",
     "Invalid byte sequence",
     "Decoded rune exceeds UTF value limit",
+    "Rune cannot be represented in the target encoding",
 };
 
 void utf_set_error(int code)
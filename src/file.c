@@ -0,0 +1,326 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Number of runes decoded between writes to the output file. */
+#define UTF_FILE_BUFFER_RUNES 4096
+
+/* Number of UTF-16 code units converted between writes to the output file. */
+#define UTF_FILE_BUFFER_UNITS 4096
+
+/* A read-only mapping of a whole file. */
+typedef struct {
+    void* addr;
+    const char* data;
+    size_t len;
+} utf_file_map_s;
+
+/* Map the file at path for reading and tell the kernel it will be read in
+ * order, so that it reads ahead aggressively. Return 0 on success, or -1 with
+ * errno set. Only regular files can be mapped, since pipes, devices and procfs
+ * files report a size of 0 whatever they hold; errno is EINVAL for anything
+ * else. An empty file is not mapped, and data is then an empty string.
+ */
+static int utf_file_map(const char* path, utf_file_map_s* map)
+{
+    struct stat st;
+    void* data;
+    int fd;
+
+    map->addr = 0;
+    map->data = "";
+    map->len = 0;
+
+    /* Without O_NONBLOCK, opening a FIFO waits for a writer. */
+    fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (st.st_size > 0) {
+        data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        map->addr = data;
+        map->data = (const char*)data;
+        map->len = (size_t)st.st_size;
+    }
+
+    close(fd);
+    return 0;
+}
+
+static void utf_file_unmap(utf_file_map_s* map)
+{
+    if (map->addr) {
+        munmap(map->addr, map->len);
+    }
+}
+
+/* Write all n bytes at buf to fd. Return 0 on success, or -1 with errno set. */
+static int utf_file_write(int fd, const void* buf, size_t n)
+{
+    const char* p = (const char*)buf;
+    ssize_t written;
+
+    while (n > 0) {
+        written = write(fd, p, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        p += written;
+        n -= (size_t)written;
+    }
+
+    return 0;
+}
+
+/* Decode the len bytes of UTF-8 at s into runes written to fd. Return the
+ * UTF_E* code of the first malformed sequence, or -1 with errno set. */
+static int utf_file_utf8_to_utf32(int fd, const char* s, size_t len)
+{
+    utf_rune buf[UTF_FILE_BUFFER_RUNES];
+    const char* p = s;
+    size_t out;
+
+    while ((size_t)(p - s) < len) {
+        out = utf_mbsnrtoufs(buf, &p, len - (size_t)(p - s),
+                             UTF_FILE_BUFFER_RUNES);
+
+        if (utf_file_write(fd, buf, out * sizeof(utf_rune)) < 0) {
+            return -1;
+        }
+
+        if (utf_errno != UTF_SUCCESS) {
+            return utf_errno;
+        }
+    }
+
+    return UTF_SUCCESS;
+}
+
+/* Copy the valid prefix of the len bytes of UTF-8 at s to fd, straight from
+ * the mapping. Return the UTF_E* code of the first malformed sequence, or -1
+ * with errno set. */
+static int utf_file_utf8_to_utf8(int fd, const char* s, size_t len)
+{
+    utf_validation_s result;
+
+    utf_validate_ex(s, len, &result);
+
+    if (utf_file_write(fd, s, result.offset) < 0) {
+        return -1;
+    }
+
+    return result.error;
+}
+
+/* Convert the len bytes of UTF-8 at s to UTF-16 code units in encoding,
+ * written to fd. Return the UTF_E* code of the first malformed sequence, or -1
+ * with errno set. */
+static int utf_file_utf8_to_utf16(int fd, const char* s, size_t len,
+                                  int encoding)
+{
+    utf_char16 buf[UTF_FILE_BUFFER_UNITS];
+    const char* p = s;
+    size_t out;
+
+    while ((size_t)(p - s) < len) {
+        out = utf_mbsnrtoutf16(buf, &p, len - (size_t)(p - s),
+                               UTF_FILE_BUFFER_UNITS, encoding);
+
+        if (utf_file_write(fd, buf, out * sizeof(utf_char16)) < 0) {
+            return -1;
+        }
+
+        if (utf_errno != UTF_SUCCESS) {
+            return utf_errno;
+        }
+    }
+
+    return UTF_SUCCESS;
+}
+
+/* Convert the len bytes of UTF-16 in encoding at s to UTF-8 written to fd. A
+ * trailing odd byte is reported as UTF_ETRUNC. Return the UTF_E* code of the
+ * first malformed sequence, or -1 with errno set. */
+static int utf_file_utf16_to_utf8(int fd, const char* s, size_t len,
+                                  int encoding)
+{
+    char buf[3 * UTF_FILE_BUFFER_UNITS];
+    const utf_char16* units = (const utf_char16*)(const void*)s;
+    const utf_char16* p = units;
+    size_t n = len / sizeof(utf_char16);
+    size_t out;
+
+    while ((size_t)(p - units) < n) {
+        out = utf_utf16snrtombs(buf, &p, n - (size_t)(p - units), sizeof(buf),
+                                encoding);
+
+        if (utf_file_write(fd, buf, out) < 0) {
+            return -1;
+        }
+
+        if (utf_errno != UTF_SUCCESS) {
+            return utf_errno;
+        }
+    }
+
+    return (len % sizeof(utf_char16)) ? UTF_ETRUNC : UTF_SUCCESS;
+}
+
+/* Convert between the len bytes at s and UTF-8 with convert, which is one of
+ * the byte-oriented conversion functions such as utf_latin1_to_utf8(), and
+ * write the result to fd. Return the UTF_E* code of the first sequence that
+ * could not be converted, or -1 with errno set. */
+static int utf_file_convert(int fd, const char* s, size_t len,
+                            size_t (*convert)(char*, const char**, size_t,
+                                              size_t))
+{
+    char buf[2 * UTF_FILE_BUFFER_UNITS];
+    const char* p = s;
+    size_t out;
+
+    while ((size_t)(p - s) < len) {
+        out = convert(buf, &p, len - (size_t)(p - s), sizeof(buf));
+
+        if (utf_file_write(fd, buf, out) < 0) {
+            return -1;
+        }
+
+        if (utf_errno != UTF_SUCCESS) {
+            return utf_errno;
+        }
+    }
+
+    return UTF_SUCCESS;
+}
+
+int utf_validate_file(const char* path, utf_validation_s* result)
+{
+    utf_file_map_s map;
+
+    if (!path || !result) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (utf_file_map(path, &map) < 0) {
+        return -1;
+    }
+
+    utf_validate_ex(map.data, map.len, result);
+    utf_file_unmap(&map);
+
+    return 0;
+}
+
+int utf_transcode_file(const char* src_path, const char* dst_path, int from,
+                       int to)
+{
+    utf_file_map_s map;
+    int status;
+    int fd;
+
+    if (!src_path || !dst_path || to < UTF_ENCODING_UTF8 ||
+            to > UTF_ENCODING_MUTF8 || from < UTF_ENCODING_UTF8 ||
+            from > UTF_ENCODING_MUTF8 || from == UTF_ENCODING_UTF32 ||
+            (from != UTF_ENCODING_UTF8 && to != UTF_ENCODING_UTF8)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (utf_file_map(src_path, &map) < 0) {
+        return -1;
+    }
+
+    fd = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        utf_file_unmap(&map);
+        return -1;
+    }
+
+    if (from == UTF_ENCODING_LATIN1) {
+        status = utf_file_convert(fd, map.data, map.len, utf_latin1_to_utf8);
+    } else if (to == UTF_ENCODING_LATIN1) {
+        status = utf_file_convert(fd, map.data, map.len, utf_utf8_to_latin1);
+    } else if (from == UTF_ENCODING_CESU8) {
+        status = utf_file_convert(fd, map.data, map.len, utf_cesu8_to_utf8);
+    } else if (to == UTF_ENCODING_CESU8) {
+        status = utf_file_convert(fd, map.data, map.len, utf_utf8_to_cesu8);
+    } else if (from == UTF_ENCODING_MUTF8) {
+        status = utf_file_convert(fd, map.data, map.len, utf_mutf8_to_utf8);
+    } else if (to == UTF_ENCODING_MUTF8) {
+        status = utf_file_convert(fd, map.data, map.len, utf_utf8_to_mutf8);
+    } else if (from != UTF_ENCODING_UTF8) {
+        status = utf_file_utf16_to_utf8(fd, map.data, map.len, from);
+    } else if (to == UTF_ENCODING_UTF32) {
+        status = utf_file_utf8_to_utf32(fd, map.data, map.len);
+    } else if (to != UTF_ENCODING_UTF8) {
+        status = utf_file_utf8_to_utf16(fd, map.data, map.len, to);
+    } else {
+        status = utf_file_utf8_to_utf8(fd, map.data, map.len);
+    }
+
+    if (close(fd) < 0) {
+        status = -1;
+    }
+
+    utf_file_unmap(&map);
+    return status;
+}
@@ -0,0 +1,364 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "bit_math.h"
+#include "error.h"
+#include "simd.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Input is validated this many bytes at a time before it is converted, as in
+ * transcode.c. */
+#define UTF_CHUNK_SIZE 4096
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Shuffles that pack four 16-bit lanes into bytes, keeping the high byte of
+ * the lanes selected by a 4-bit mask. */
+static const unsigned char utf_latin1_pack[16][16] = {
+    { 0, 2, 4, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 4, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 3, 4, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 3, 4, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 4, 5, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 4, 5, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 3, 4, 5, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 3, 4, 5, 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 4, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 4, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 3, 4, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 3, 4, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 3, 4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+};
+
+/* Shuffles that pack the bytes selected by a 4-bit mask to the front. */
+static const unsigned char utf_latin1_keep[16][16] = {
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 1, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 1, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 1, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 2, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 2, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 1, 2, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0, 1, 2, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+};
+
+/* Encode the 4 Latin-1 bytes held in the 16-bit lanes of v, of which those in
+ * mask are above 0x7F, and store 8 bytes at dest. Return the number of bytes
+ * that were encoded.
+ */
+static size_t utf_latin1_encode_4(__m128i v, unsigned int mask,
+                                  unsigned char* dest)
+{
+    __m128i two = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0)),
+        _mm_slli_epi16(_mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x3F)),
+                                    _mm_set1_epi16(0x80)), 8));
+    __m128i is_2 = _mm_cmpgt_epi16(v, _mm_set1_epi16(0x7F));
+
+    v = _mm_or_si128(_mm_and_si128(is_2, two), _mm_andnot_si128(is_2, v));
+    _mm_storel_epi64((__m128i*)(void*)dest, _mm_shuffle_epi8(v,
+        _mm_loadu_si128((const __m128i*)(const void*)utf_latin1_pack[mask])));
+
+    return 4 + (size_t)utf_popcount(mask);
+}
+
+/* Keep the 4 bytes at the start of v selected by mask, and store 4 bytes at
+ * dest. Return the number of bytes kept.
+ */
+static size_t utf_latin1_keep_4(__m128i v, unsigned int mask,
+                                unsigned char* dest)
+{
+    int packed = _mm_cvtsi128_si32(_mm_shuffle_epi8(v,
+        _mm_loadu_si128((const __m128i*)(const void*)utf_latin1_keep[mask])));
+
+    memcpy(dest, &packed, 4);
+    return (size_t)utf_popcount(mask);
+}
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+size_t utf_latin1_to_utf8(char* dest, const char** src, size_t n, size_t len)
+{
+    const unsigned char* s;
+    unsigned char* d = (unsigned char*)dest;
+    size_t i = 0;
+    size_t out = 0;
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i v;
+    unsigned int high;
+#  if defined(UTF_SIMD_LOOKUP)
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo, hi;
+#  else
+    size_t stop;
+#  endif
+#endif
+
+    utf_set_error(UTF_SUCCESS);
+
+    if (!src || !*src) {
+        return 0;
+    }
+
+    s = (const unsigned char*)*src;
+
+#if defined(UTF_SIMD_WIDTH)
+    /* Each byte above 0x7F adds a byte to the output. */
+    while (n - i >= 16 && (!d || len - out >= 40)) {
+        v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+        high = (unsigned int)_mm_movemask_epi8(v);
+
+        if (!d) {
+            out += 16 + (size_t)utf_popcount(high);
+            i += 16;
+            continue;
+        }
+
+        if (!high) {
+            _mm_storeu_si128((__m128i*)(void*)(d + out), v);
+            i += 16;
+            out += 16;
+            continue;
+        }
+
+#  if defined(UTF_SIMD_LOOKUP)
+        lo = _mm_unpacklo_epi8(v, zero);
+        hi = _mm_unpackhi_epi8(v, zero);
+        out += utf_latin1_encode_4(lo, high & 0x0F, d + out);
+        out += utf_latin1_encode_4(_mm_srli_si128(lo, 8), (high >> 4) & 0x0F,
+                                   d + out);
+        out += utf_latin1_encode_4(hi, (high >> 8) & 0x0F, d + out);
+        out += utf_latin1_encode_4(_mm_srli_si128(hi, 8), high >> 12, d + out);
+        i += 16;
+#  else
+        for (stop = i + 16; i < stop; i++) {
+            if (s[i] < 0x80) {
+                d[out++] = s[i];
+            } else {
+                utf_utf8_encode_2(s[i], d + out);
+                out += 2;
+            }
+        }
+#  endif
+    }
+#endif
+
+    for (; i < n; i++) {
+        if (s[i] < 0x80) {
+            if (d) {
+                if (out >= len) {
+                    break;
+                }
+                d[out] = s[i];
+            }
+            out++;
+            continue;
+        }
+
+        if (d) {
+            if (len - out < 2) {
+                break;
+            }
+            utf_utf8_encode_2(s[i], d + out);
+        }
+        out += 2;
+    }
+
+    *src += i;
+    return out;
+}
+
+/* Convert the valid UTF-8 from *pos up to end into at most cap bytes of
+ * Latin-1 at dest, or just count them if dest is a null pointer, and advance
+ * *pos past the bytes consumed. Conversion stops in front of the first rune
+ * above U+00FF, and UTF_ERANGE is then stored in *error. Return the number of
+ * bytes written.
+ */
+static size_t utf_latin1_from_valid(const unsigned char* s, size_t* pos,
+                                    size_t end, unsigned char* dest,
+                                    size_t cap, int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t n;
+    utf_rune r;
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i v;
+#  if defined(UTF_SIMD_LOOKUP)
+    __m128i next, value;
+    unsigned int keep;
+#  else
+    size_t stop;
+#  endif
+
+    while (dest && end - i >= 17 && cap - out >= 16) {
+        v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+
+        if (!_mm_movemask_epi8(v)) {
+            _mm_storeu_si128((__m128i*)(void*)(dest + out), v);
+            i += 16;
+            out += 16;
+            continue;
+        }
+
+#  if defined(UTF_SIMD_LOOKUP)
+        /* Only C2 and C3 lead runes below U+0100, so the scalar code takes
+         * over at bytes from C4 up, which are the negative bytes above C3. */
+        if (_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpgt_epi8(v, _mm_set1_epi8((char)0xC3)),
+                _mm_cmplt_epi8(v, _mm_setzero_si128())))) {
+            break;
+        }
+
+        /* A lead byte and the continuation byte after it make a rune. */
+        next = _mm_loadu_si128((const __m128i*)(const void*)(s + i + 1));
+        value = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi8(0x03)), 6),
+            _mm_and_si128(next, _mm_set1_epi8(0x3F)));
+        value = _mm_or_si128(
+            _mm_and_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()), value),
+            _mm_andnot_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()), v));
+        /* Every byte but a continuation byte gives an output byte. */
+        keep = (unsigned int)_mm_movemask_epi8(
+            _mm_cmpgt_epi8(v, _mm_set1_epi8((char)0xBF)));
+
+        out += utf_latin1_keep_4(value, keep & 0x0F, dest + out);
+        out += utf_latin1_keep_4(_mm_srli_si128(value, 4),
+                                 (keep >> 4) & 0x0F, dest + out);
+        out += utf_latin1_keep_4(_mm_srli_si128(value, 8),
+                                 (keep >> 8) & 0x0F, dest + out);
+        out += utf_latin1_keep_4(_mm_srli_si128(value, 12),
+                                 (keep >> 12) & 0x0F, dest + out);
+        i += 16;
+
+        /* Skip the tail of a rune that started in the converted bytes. */
+        if (utf_utf8_is_cont(s[i])) {
+            i++;
+        }
+#  else
+        for (stop = i + 16; i < stop; i += n) {
+            r = utf_utf8_decode(s + i, &n);
+
+            if (r > 0xFF) {
+                *error = UTF_ERANGE;
+                *pos = i;
+                return out;
+            }
+
+            dest[out++] = (unsigned char)r;
+        }
+#  endif
+    }
+#endif
+
+    while (i < end) {
+        r = utf_utf8_decode(s + i, &n);
+
+        if (r > 0xFF) {
+            *error = UTF_ERANGE;
+            break;
+        }
+
+        if (dest) {
+            if (out >= cap) {
+                break;
+            }
+            dest[out] = (unsigned char)r;
+        }
+
+        out++;
+        i += n;
+    }
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_utf8_to_latin1(char* dest, const char** src, size_t n, size_t len)
+{
+    const unsigned char* s;
+    unsigned char* d = (unsigned char*)dest;
+    size_t i = 0;
+    size_t out = 0;
+    size_t valid = 0;
+    size_t end;
+    int error = UTF_SUCCESS;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    s = (const unsigned char*)*src;
+
+    while (i < n && (!d || out < len)) {
+        end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+        valid = i + utf_validate_prefix((const char*)s + i, end - i, &error);
+
+        if (error == UTF_ETRUNC && end < n) {
+            /* Only the chunk was cut short, so the next one picks it up. */
+            error = UTF_SUCCESS;
+        }
+
+        out += utf_latin1_from_valid(s, &i, valid, d ? d + out : 0, len - out,
+                                     &error);
+
+        if (error != UTF_SUCCESS || i < valid) {
+            break;
+        }
+    }
+
+    if (i < valid && error != UTF_ERANGE) {
+        /* Stopped early because dest is full. */
+        error = UTF_SUCCESS;
+    }
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
@@ -1,4 +1,4 @@
-SRCS    := bit_math.c decode.c encode.c properties.c state.c error.c           \
-		   ucd.c
+SRCS    := alloc.c bit_math.c classify.c decode.c encode.c properties.c        \
+		   state.c error.c cesu8.c file.c latin1.c parallel.c          \
+		   transcode.c ucd.c utf16.c utf8.c validate.c view.c
 SUBDIRS +=
-
@@ -0,0 +1,278 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "error.h"
+#include "transcode.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Buffers are only split when every thread gets at least this many bytes, so
+ * that the thread start-up cost stays small next to the work. */
+#define UTF_MT_MIN_CHUNK ((size_t)1 << 20)
+#define UTF_MT_MAX_THREADS 64
+
+/* A chunk of the input, handled by one thread. Validation fills in stop, runes
+ * and error, and decoding writes runes to dest from start up to stop.
+ */
+typedef struct {
+    const unsigned char* s;
+    size_t start;
+    size_t end;
+    size_t stop;
+    size_t runes;
+    int error;
+    utf_rune* dest;
+    size_t cap;
+} utf_mt_chunk_s;
+
+typedef void* (*utf_mt_work_fn)(void*);
+
+/* Return the number of threads to use for len bytes, given the number asked
+ * for, where 0 or less means one per online processor. */
+static int utf_mt_threads(size_t len, int threads)
+{
+    long online;
+
+    if (threads <= 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (int)online : 1;
+    }
+
+    if (threads > UTF_MT_MAX_THREADS) {
+        threads = UTF_MT_MAX_THREADS;
+    }
+
+    if ((size_t)threads > len / UTF_MT_MIN_CHUNK) {
+        threads = (int)(len / UTF_MT_MIN_CHUNK);
+    }
+
+    return (threads > 0) ? threads : 1;
+}
+
+/* Split the len bytes at s into count chunks of about the same size. Each
+ * boundary is moved back to the nearest byte that is not a continuation byte,
+ * so valid input is split between runes.
+ */
+static void utf_mt_split(const unsigned char* s, size_t len,
+                         utf_mt_chunk_s* chunks, int count)
+{
+    size_t size = len / (size_t)count;
+    size_t at;
+    int k, back;
+
+    for (k = 0; k < count; k++) {
+        at = (k == 0) ? 0 : size * (size_t)k;
+
+        for (back = 0; back < 3 && at > 0 && utf_utf8_is_cont(s[at]); back++) {
+            at--;
+        }
+
+        chunks[k].s = s;
+        chunks[k].start = at;
+        chunks[k].runes = 0;
+        chunks[k].error = UTF_SUCCESS;
+        chunks[k].dest = 0;
+        chunks[k].cap = 0;
+
+        if (k > 0) {
+            chunks[k - 1].end = at;
+        }
+    }
+
+    chunks[count - 1].end = len;
+}
+
+/* Run work on every chunk, one thread each. The calling thread takes the first
+ * chunk, and any chunk whose thread cannot be started is run inline.
+ */
+static void utf_mt_run(utf_mt_work_fn work, utf_mt_chunk_s* chunks, int count)
+{
+    pthread_t threads[UTF_MT_MAX_THREADS];
+    bool started[UTF_MT_MAX_THREADS];
+    int k;
+
+    for (k = 1; k < count; k++) {
+        started[k] = pthread_create(&threads[k], 0, work, &chunks[k]) == 0;
+    }
+
+    work(&chunks[0]);
+
+    for (k = 1; k < count; k++) {
+        if (started[k]) {
+            pthread_join(threads[k], 0);
+        } else {
+            work(&chunks[k]);
+        }
+    }
+}
+
+static void* utf_mt_validate(void* arg)
+{
+    utf_mt_chunk_s* chunk = (utf_mt_chunk_s*)arg;
+
+    chunk->stop = chunk->start + utf_validate_count(
+        (const char*)chunk->s + chunk->start, chunk->end - chunk->start,
+        &chunk->error, &chunk->runes);
+
+    return 0;
+}
+
+static void* utf_mt_decode(void* arg)
+{
+    utf_mt_chunk_s* chunk = (utf_mt_chunk_s*)arg;
+    size_t pos = chunk->start;
+
+    chunk->runes = utf_decode_valid(chunk->s, &pos, chunk->stop, chunk->dest,
+                                    chunk->cap);
+    chunk->stop = pos;
+
+    return 0;
+}
+
+/* Combine the validated chunks in order, fixing up a rune that straddles a
+ * boundary, which only happens when invalid input leaves a run of continuation
+ * bytes there. Return the number of chunks up to and including the first one
+ * that stopped at an error, which is stored in *error.
+ */
+static int utf_mt_merge(utf_mt_chunk_s* chunks, int count, size_t len,
+                        int* error)
+{
+    utf_mt_chunk_s* chunk;
+    size_t n;
+    int k;
+
+    for (k = 0; k < count; k++) {
+        chunk = &chunks[k];
+
+        if (chunk->error == UTF_ETRUNC && k + 1 < count) {
+            chunk->error = utf_utf8_check(chunk->s + chunk->stop,
+                                          len - chunk->stop, &n);
+
+            if (chunk->error == UTF_SUCCESS) {
+                /* The next chunk starts inside this rune, so it is validated
+                 * again from the end of it. */
+                chunk->stop += n;
+                chunk->runes++;
+                chunks[k + 1].start = chunk->stop;
+                utf_mt_validate(&chunks[k + 1]);
+            }
+        }
+
+        if (chunk->error != UTF_SUCCESS) {
+            *error = chunk->error;
+            return k + 1;
+        }
+    }
+
+    *error = UTF_SUCCESS;
+    return count;
+}
+
+bool utf_validate_mt(const char* s, size_t len, utf_validation_s* result,
+                     int threads)
+{
+    utf_mt_chunk_s chunks[UTF_MT_MAX_THREADS];
+    utf_validation_s dummy;
+    int count, k;
+
+    if (!result) {
+        result = &dummy;
+    }
+
+    if (!s) {
+        return utf_validate_ex(s, len, result);
+    }
+
+    count = utf_mt_threads(len, threads);
+    utf_mt_split((const unsigned char*)s, len, chunks, count);
+    utf_mt_run(utf_mt_validate, chunks, count);
+    count = utf_mt_merge(chunks, count, len, &result->error);
+
+    result->runes = 0;
+    for (k = 0; k < count; k++) {
+        result->runes += chunks[k].runes;
+    }
+    result->offset = chunks[count - 1].stop;
+
+    return result->error == UTF_SUCCESS;
+}
+
+size_t utf_mbsnrtoufs_mt(utf_rune* dest, const char** src, size_t n,
+                         size_t len, int threads)
+{
+    utf_mt_chunk_s chunks[UTF_MT_MAX_THREADS];
+    size_t out = 0;
+    int count, k;
+    int error;
+
+    if (!src || !*src || (dest && len == 0)) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    count = utf_mt_threads(n, threads);
+    utf_mt_split((const unsigned char*)*src, n, chunks, count);
+    utf_mt_run(utf_mt_validate, chunks, count);
+    count = utf_mt_merge(chunks, count, n, &error);
+
+    if (dest) {
+        /* A prefix sum of the rune counts places each chunk in dest. */
+        for (k = 0; k < count; k++) {
+            chunks[k].dest = dest + out;
+            chunks[k].cap = (len - out < chunks[k].runes) ?
+                len - out : chunks[k].runes;
+            out += chunks[k].cap;
+
+            if (chunks[k].cap < chunks[k].runes) {
+                /* Stopped early because dest is full. */
+                error = UTF_SUCCESS;
+                count = k + 1;
+                break;
+            }
+        }
+
+        utf_mt_run(utf_mt_decode, chunks, count);
+    } else {
+        for (k = 0; k < count; k++) {
+            out += chunks[k].runes;
+        }
+    }
+
+    *src += chunks[count - 1].stop;
+    utf_set_error(error);
+    return out;
+}
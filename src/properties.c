@@ -25,9 +25,6 @@ SPDX-FileCopyrightText: 2020 Ryan Egesdahl
 SPDX-License-Identifier: MIT
 */
 
-#include <assert.h>
-#include <stdlib.h>
-
 #include <utf/utf.h>
 
 #include "ucd.h"
@@ -115,74 +112,55 @@ int utf_runelen(uint_least32_t w)
     return -1;
 }
 
-int rune_cmp(const void* a, const void* b)
-{
-    utf_rune* rune_a = (utf_rune*)a;
-    utf_rune* rune_b = (utf_rune*)b;
-
-    assert(rune_a);
-    assert(rune_b);
+#define UTF_UCD_MATCH_FN(fn_name,class_mask)                                   \
+bool fn_name(utf_rune r)                                                       \
+{                                                                              \
+    return (utf_ucd_lookup(r) & (class_mask)) ? true : false;                  \
+}
 
-    return (int)(*rune_a - *rune_b);
+uint_least32_t utf_properties(utf_rune r)
+{
+    return utf_ucd_lookup(r) & UTF_UCD_CLASS_MASK;
 }
 
-#define UTF_UCD_MATCH_FN(fn_name,array_name)                                   \
-bool fn_name(utf_rune r)                                                       \
-{                                                                              \
-    static const size_t num_runes = sizeof((array_name)) / sizeof(utf_rune);   \
-    utf_rune* match = (utf_rune*)bsearch(                                      \
-            &r,                                                                \
-            (array_name),                                                      \
-            num_runes,                                                         \
-            sizeof(utf_rune),                                                  \
-            rune_cmp);                                                         \
-                                                                               \
-    if (match && *match == r) {                                                \
-        return true;                                                           \
-    }                                                                          \
-                                                                               \
-    return false;                                                              \
+int utf_category(utf_rune r)
+{
+    return (int)(utf_ucd_lookup(r) >> UTF_UCD_CATEGORY_SHIFT);
 }
 
-UTF_UCD_MATCH_FN(utf_isalpha, utf_ucd_alphabetic)
+UTF_UCD_MATCH_FN(utf_isalpha, UTF_CLASS_ALPHA)
 
-UTF_UCD_MATCH_FN(utf_iscntrl, utf_ucd_control)
+UTF_UCD_MATCH_FN(utf_iscntrl, UTF_CLASS_CNTRL)
 
-UTF_UCD_MATCH_FN(utf_isdigit, utf_ucd_digit)
+UTF_UCD_MATCH_FN(utf_isdigit, UTF_CLASS_DIGIT)
 
-bool utf_isalnum(utf_rune r)
-{
-    return utf_isalpha(r) || utf_isdigit(r);
-}
+UTF_UCD_MATCH_FN(utf_isalnum, UTF_CLASS_ALNUM)
 
-UTF_UCD_MATCH_FN(utf_isnumber, utf_ucd_numeric)
+UTF_UCD_MATCH_FN(utf_isnumber, UTF_CLASS_NUMBER)
 
-UTF_UCD_MATCH_FN(utf_isinteger, utf_ucd_integer)
+UTF_UCD_MATCH_FN(utf_isinteger, UTF_CLASS_INTEGER)
 
-UTF_UCD_MATCH_FN(utf_islower, utf_ucd_lowercase)
+UTF_UCD_MATCH_FN(utf_islower, UTF_CLASS_LOWER)
 
-UTF_UCD_MATCH_FN(utf_isprint, utf_ucd_printable)
+UTF_UCD_MATCH_FN(utf_isprint, UTF_CLASS_PRINT)
 
-UTF_UCD_MATCH_FN(utf_ispunct, utf_ucd_punctuation)
+UTF_UCD_MATCH_FN(utf_ispunct, UTF_CLASS_PUNCT)
 
-UTF_UCD_MATCH_FN(utf_isblank, utf_ucd_blank)
+UTF_UCD_MATCH_FN(utf_isblank, UTF_CLASS_BLANK)
 
-UTF_UCD_MATCH_FN(utf_isspace, utf_ucd_space)
+UTF_UCD_MATCH_FN(utf_isspace, UTF_CLASS_SPACE)
 
-bool utf_isgraph(utf_rune r)
-{
-    return utf_isprint(r) && !utf_isspace(r);
-}
+UTF_UCD_MATCH_FN(utf_isgraph, UTF_CLASS_GRAPH)
 
-UTF_UCD_MATCH_FN(utf_isupper, utf_ucd_uppercase)
+UTF_UCD_MATCH_FN(utf_isupper, UTF_CLASS_UPPER)
 
-UTF_UCD_MATCH_FN(utf_istitle, utf_ucd_titlecase)
+UTF_UCD_MATCH_FN(utf_istitle, UTF_CLASS_TITLE)
 
-UTF_UCD_MATCH_FN(utf_issymbol, utf_ucd_symbol)
+UTF_UCD_MATCH_FN(utf_issymbol, UTF_CLASS_SYMBOL)
 
-UTF_UCD_MATCH_FN(utf_iscurrency, utf_ucd_currency)
+UTF_UCD_MATCH_FN(utf_iscurrency, UTF_CLASS_CURRENCY)
 
-UTF_UCD_MATCH_FN(utf_ismath, utf_ucd_mathematic)
+UTF_UCD_MATCH_FN(utf_ismath, UTF_CLASS_MATH)
 
 bool utf_isxdigit(utf_rune r)
 {
@@ -191,3 +169,18 @@ bool utf_isxdigit(utf_rune r)
         (r >= 'A' && r <= 'F') ||
         (r >= 'a' && r <= 'f');
 }
+
+utf_rune utf_tolower(utf_rune r)
+{
+    return utf_ucd_case(utf_ucd_lower_deltas, r);
+}
+
+utf_rune utf_toupper(utf_rune r)
+{
+    return utf_ucd_case(utf_ucd_upper_deltas, r);
+}
+
+utf_rune utf_totitle(utf_rune r)
+{
+    return utf_ucd_case(utf_ucd_title_deltas, r);
+}
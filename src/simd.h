@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_SIMD_H
+#define UTF_SIMD_H
+
+/* The vector kernels are selected at compile time from the instruction sets
+ * the compiler was told it may use (see ARCH_FLAGS in config.mk). Without any
+ * of them, every bulk function falls back to portable scalar code.
+ */
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define UTF_SIMD_AVX2 1
+#  define UTF_SIMD_LOOKUP 1
+#  define UTF_SIMD_WIDTH 32
+#elif defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define UTF_SIMD_SSSE3 1
+#  define UTF_SIMD_LOOKUP 1
+#  define UTF_SIMD_WIDTH 16
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#  define UTF_SIMD_SSE2 1
+#  define UTF_SIMD_WIDTH 16
+#endif
+
+#if defined(UTF_SIMD_AVX2)
+typedef __m256i utf_vec;
+
+#  define utf_vec_load(p) _mm256_loadu_si256((const __m256i*)(const void*)(p))
+#  define utf_vec_store(p, v) \
+    _mm256_storeu_si256((__m256i*)(void*)(p), (v))
+#  define utf_vec_table(p) \
+    _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(const void*)(p)))
+#  define utf_vec_set1(c) _mm256_set1_epi8((char)(c))
+#  define utf_vec_zero() _mm256_setzero_si256()
+#  define utf_vec_or(a, b) _mm256_or_si256((a), (b))
+#  define utf_vec_and(a, b) _mm256_and_si256((a), (b))
+#  define utf_vec_xor(a, b) _mm256_xor_si256((a), (b))
+#  define utf_vec_eq(a, b) _mm256_cmpeq_epi8((a), (b))
+#  define utf_vec_gt(a, b) _mm256_cmpgt_epi8((a), (b))
+#  define utf_vec_max(a, b) _mm256_max_epu8((a), (b))
+#  define utf_vec_subs(a, b) _mm256_subs_epu8((a), (b))
+#  define utf_vec_shr4(v) _mm256_srli_epi16((v), 4)
+#  define utf_vec_lookup(t, i) _mm256_shuffle_epi8((t), (i))
+#  define utf_vec_mask(v) ((unsigned int)_mm256_movemask_epi8((v)))
+#  define utf_vec_any(v) \
+    (utf_vec_mask(utf_vec_eq((v), utf_vec_zero())) != 0xFFFFFFFFU)
+#  define utf_vec_prev(v, p, n) \
+    _mm256_alignr_epi8((v), _mm256_permute2x128_si256((p), (v), 0x21), 16 - (n))
+#elif defined(UTF_SIMD_WIDTH)
+typedef __m128i utf_vec;
+
+#  define utf_vec_load(p) _mm_loadu_si128((const __m128i*)(const void*)(p))
+#  define utf_vec_store(p, v) _mm_storeu_si128((__m128i*)(void*)(p), (v))
+#  define utf_vec_table(p) utf_vec_load((p))
+#  define utf_vec_set1(c) _mm_set1_epi8((char)(c))
+#  define utf_vec_zero() _mm_setzero_si128()
+#  define utf_vec_or(a, b) _mm_or_si128((a), (b))
+#  define utf_vec_and(a, b) _mm_and_si128((a), (b))
+#  define utf_vec_xor(a, b) _mm_xor_si128((a), (b))
+#  define utf_vec_eq(a, b) _mm_cmpeq_epi8((a), (b))
+#  define utf_vec_gt(a, b) _mm_cmpgt_epi8((a), (b))
+#  define utf_vec_max(a, b) _mm_max_epu8((a), (b))
+#  define utf_vec_subs(a, b) _mm_subs_epu8((a), (b))
+#  define utf_vec_shr4(v) _mm_srli_epi16((v), 4)
+#  define utf_vec_mask(v) ((unsigned int)_mm_movemask_epi8((v)))
+#  define utf_vec_any(v) \
+    (utf_vec_mask(utf_vec_eq((v), utf_vec_zero())) != 0xFFFFU)
+#  if defined(UTF_SIMD_LOOKUP)
+#    define utf_vec_lookup(t, i) _mm_shuffle_epi8((t), (i))
+#    define utf_vec_prev(v, p, n) _mm_alignr_epi8((v), (p), 16 - (n))
+#  endif
+#endif
+
+#if defined(UTF_SIMD_WIDTH)
+/* Mask of the bytes in v that are not continuation bytes, which as signed
+ * bytes are exactly those greater than (char)0xBF. */
+#  define utf_vec_leads(v) utf_vec_mask(utf_vec_gt((v), utf_vec_set1(0xBF)))
+#endif
+
+#endif /* UTF_SIMD_H */
@@ -26,39 +26,52 @@ SPDX-License-Identifier: MIT
 */
 
 #include <string.h>
-#include <stdlib.h>
 
 #include <utf/utf.h>
 #include <utf/platform.h>
 
+#include "alloc.h"
 #include "state.h"
 
-utf_state_p utf_state_alloc(void)
+utf_state_p utf_state_alloc(const utf_allocator_s* allocator)
 {
     utf_state_p state = 0;
 
-    state = (utf_state_p)calloc(1, sizeof(utf_state_s));
+    allocator = utf_allocator(allocator);
+    state = (utf_state_p)utf_alloc(allocator, sizeof(utf_state_s));
     if (!state) {
-        abort();
+        return 0;
     }
 
+    memset(state, 0, sizeof(utf_state_s));
+    state->allocator = *allocator;
     return state;
 }
 
 utf_state_p utf_state_new(void)
 {
-    utf_state_p state = utf_state_alloc();
+    utf_state_p state = utf_state_alloc(0);
     return state;
 }
 
+utf_state_p utf_state_new_with(const utf_allocator_s* allocator)
+{
+    return utf_state_alloc(allocator);
+}
+
 void utf_state_destroy(utf_state_p state)
 {
-    free(state);
+    if (state) {
+        utf_free(&state->allocator, state, sizeof(utf_state_s));
+    }
 }
 
 void utf_state_clear(utf_state_p state)
 {
+    utf_allocator_s allocator = state->allocator;
+
     memset(state, 0, sizeof(utf_state_s));
+    state->allocator = allocator;
 }
 
 int utf_state_get_error(utf_state_p state)
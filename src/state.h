@@ -29,6 +29,7 @@ SPDX-License-Identifier: MIT
 #define UTF_STATE_H
 
 #include <utf/platform.h>
+#include <utf/utf.h>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wc99-extensions"
@@ -41,6 +42,8 @@ struct utf_state_s {
     } value;
     int errno;
     bool is_big_endian;
+    unsigned int dfa;
+    utf_allocator_s allocator;
 };
 
 #endif /* UTF_STATE_H */
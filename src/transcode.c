@@ -0,0 +1,900 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "error.h"
+#include "bit_math.h"
+#include "simd.h"
+#include "state.h"
+#include "transcode.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Input is validated this many bytes at a time before it is decoded, so that
+ * both passes run over data that is still in the L1 cache. */
+#define UTF_CHUNK_SIZE 4096
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Shuffles that pack the 32-bit lanes selected by a 4-bit mask to the front. */
+static const unsigned char utf_pack_lanes[16][16] = {
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80 },
+    { 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80 },
+    { 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F },
+};
+
+static const unsigned char utf_nibble_bits[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+/* Gathers bytes i to i + 3 of the input into 32-bit lane i. */
+static const unsigned char utf_gather_4[16] = {
+    0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6
+};
+
+#define utf_select(m, a, b) \
+    _mm_or_si128(_mm_and_si128((m), (a)), _mm_andnot_si128((m), (b)))
+
+/* Decode the runes that start in the 16 bytes at s, which must be valid UTF-8
+ * with at least three more bytes after them. Every byte is decoded as if it
+ * began a rune, and the lanes of continuation bytes are then packed away.
+ * Return the number of runes written, which is at most 16.
+ */
+size_t utf_decode_16(const unsigned char* s, utf_rune* dest)
+{
+    __m128i gather = _mm_loadu_si128((const __m128i*)(const void*)utf_gather_4);
+    __m128i low_byte = _mm_set1_epi32(0xFF);
+    __m128i low_six = _mm_set1_epi32(0x3F);
+    __m128i w, b0, c1, c2, c3, v;
+    unsigned int leads, lanes;
+    size_t out = 0;
+    int k;
+
+    leads = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(
+        _mm_loadu_si128((const __m128i*)(const void*)s), _mm_set1_epi8(-65)));
+
+    for (k = 0; k < 16; k += 4) {
+        lanes = (leads >> k) & 0x0F;
+        if (!lanes) {
+            continue;
+        }
+
+        w = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i*)(const void*)(s + k)), gather);
+        b0 = _mm_and_si128(w, low_byte);
+        c1 = _mm_and_si128(_mm_srli_epi32(w, 8), low_six);
+        c2 = _mm_and_si128(_mm_srli_epi32(w, 16), low_six);
+        c3 = _mm_and_si128(_mm_srli_epi32(w, 24), low_six);
+
+        v = utf_select(_mm_cmpgt_epi32(b0, _mm_set1_epi32(0xBF)),
+            _mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(b0, _mm_set1_epi32(0x1F)), 6),
+                c1),
+            b0);
+        v = utf_select(_mm_cmpgt_epi32(b0, _mm_set1_epi32(0xDF)),
+            _mm_or_si128(_mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(b0, _mm_set1_epi32(0x0F)), 12),
+                _mm_slli_epi32(c1, 6)), c2),
+            v);
+        v = utf_select(_mm_cmpgt_epi32(b0, _mm_set1_epi32(0xEF)),
+            _mm_or_si128(_mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(b0, _mm_set1_epi32(0x07)), 18),
+                _mm_slli_epi32(c1, 12)),
+                _mm_or_si128(_mm_slli_epi32(c2, 6), c3)),
+            v);
+
+        v = _mm_shuffle_epi8(v, _mm_loadu_si128(
+            (const __m128i*)(const void*)utf_pack_lanes[lanes]));
+        _mm_storeu_si128((__m128i*)(void*)(dest + out), v);
+        out += utf_nibble_bits[lanes];
+    }
+
+    return out;
+}
+
+#undef utf_select
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+#if defined(UTF_SIMD_WIDTH)
+
+/* Widen the 16 ASCII bytes in v to runes. */
+static void utf_widen_16(__m128i v, utf_rune* dest)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    _mm_storeu_si128((__m128i*)(void*)dest, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(void*)(dest + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(void*)(dest + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i*)(void*)(dest + 12), _mm_unpackhi_epi16(hi, zero));
+}
+
+#endif /* defined(UTF_SIMD_WIDTH) */
+
+size_t utf_decode_valid(const unsigned char* s, size_t* pos, size_t end,
+                        utf_rune* dest, size_t cap)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t n;
+
+#if defined(UTF_SIMD_WIDTH)
+    utf_vec v;
+#  if !defined(UTF_SIMD_LOOKUP)
+    size_t stop;
+#  endif
+
+    if (sizeof(utf_rune) == 4) {
+        while (end - i >= 32 && cap - out >= 32) {
+            v = utf_vec_load(s + i);
+#  if UTF_SIMD_WIDTH == 16
+            if (!utf_vec_mask(utf_vec_or(v, utf_vec_load(s + i + 16)))) {
+#  else
+            if (!utf_vec_mask(v)) {
+#  endif
+                utf_widen_16(_mm_loadu_si128((const __m128i*)(const void*)(s + i)),
+                             dest + out);
+                utf_widen_16(_mm_loadu_si128((const __m128i*)(const void*)(s + i + 16)),
+                             dest + out + 16);
+                i += 32;
+                out += 32;
+                continue;
+            }
+
+#  if defined(UTF_SIMD_LOOKUP)
+            out += utf_decode_16(s + i, dest + out);
+            i += 16;
+
+            /* Skip the tail of a rune that started in the decoded bytes. */
+            while (utf_utf8_is_cont(s[i])) {
+                i++;
+            }
+#  else
+            for (stop = i + 16; i < stop; i += n) {
+                dest[out++] = utf_utf8_decode(s + i, &n);
+            }
+#  endif
+        }
+    }
+#endif
+
+    while (i < end && out < cap) {
+        dest[out++] = utf_utf8_decode(s + i, &n);
+        i += n;
+    }
+
+    *pos = i;
+    return out;
+}
+
+/* Decode the n bytes at s from *pos into at most len runes in dest, or just
+ * count them if dest is a null pointer. Decoding stops in front of the first
+ * malformed sequence, whose error is stored in error, and *pos is advanced past
+ * the bytes consumed. Return the number of runes written.
+ */
+static size_t utf_decode_utf8(const unsigned char* s, size_t* pos, size_t n,
+                              utf_rune* dest, size_t len, int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t valid = i;
+    size_t end;
+
+    *error = UTF_SUCCESS;
+
+    while (i < n && (!dest || out < len)) {
+        end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+        valid = i + utf_validate_prefix((const char*)s + i, end - i, error);
+
+        if (*error == UTF_ETRUNC && end < n) {
+            /* Only the chunk was cut short, so the next one picks it up. */
+            *error = UTF_SUCCESS;
+        }
+
+        if (dest) {
+            out += utf_decode_valid(s, &i, valid, dest + out, len - out);
+        } else {
+            out += utf_runecount((const char*)s + i, valid - i);
+            i = valid;
+        }
+
+        if (*error != UTF_SUCCESS || i < valid) {
+            break;
+        }
+    }
+
+    if (i < valid) {
+        /* Stopped early because dest is full. */
+        *error = UTF_SUCCESS;
+    }
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_mbsnrtoufs(utf_rune* dest, const char** src, size_t n, size_t len)
+{
+    size_t i = 0;
+    size_t out;
+    int error;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    out = utf_decode_utf8((const unsigned char*)*src, &i, n, dest, len, &error);
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
+
+int utf_decode_stream_r(utf_state_p state, const char* in, size_t in_len,
+                        utf_rune* out, size_t out_cap, size_t* consumed,
+                        size_t* produced)
+{
+    size_t i = 0;
+    size_t o = 0;
+    utf_rune rune;
+    int error = UTF_SUCCESS;
+    int n;
+
+    assert(state);
+    assert(consumed);
+    assert(produced);
+
+    state->errno = UTF_SUCCESS;
+
+    if (!in) {
+        in_len = 0;
+    }
+
+    if (state->count > 0 && in_len > 0 && (!out || out_cap > 0)) {
+        /* Finish the rune left over from the previous buffer first. */
+        n = utf_decode_dfa_r(&rune, (char*)in,
+                             (in_len > UTF_BYTES_MAX) ? UTF_BYTES_MAX : (int)in_len,
+                             state);
+        i = (size_t)n;
+        error = state->errno;
+
+        if (error == UTF_SUCCESS) {
+            if (out) {
+                out[0] = rune;
+            }
+
+            o = 1;
+        }
+    }
+
+    if (error == UTF_SUCCESS) {
+        o += utf_decode_utf8((const unsigned char*)in, &i, in_len,
+                             out ? out + o : 0, out_cap - o, &error);
+    }
+
+    if (error == UTF_ETRUNC) {
+        /* Keep the trailing partial rune in state for the next buffer. */
+        i += (size_t)utf_decode_dfa_r(&rune, (char*)in + i, (int)(in_len - i),
+                                      state);
+        error = UTF_SUCCESS;
+    }
+
+    state->errno = error;
+    *consumed = i;
+    *produced = o;
+    return error;
+}
+
+size_t utf_mbsrtoufs(utf_rune* dest, const char** src, size_t len)
+{
+    size_t out;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    out = utf_mbsnrtoufs(dest, src, strlen(*src), len);
+
+    if (dest && out < len && !**src) {
+        dest[out] = 0;
+    }
+
+    return out;
+}
+
+size_t utf_mbsnrtoufs_lossy(utf_rune* dest, const char** src, size_t n,
+                            size_t len)
+{
+    const unsigned char* s;
+    size_t i = 0;
+    size_t out = 0;
+    size_t skip;
+    int first = UTF_SUCCESS;
+    int error;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    s = (const unsigned char*)*src;
+
+    while (i < n && (!dest || out < len)) {
+        out += utf_decode_utf8(s, &i, n, dest ? dest + out : 0, len - out,
+                               &error);
+
+        if (error == UTF_SUCCESS || (dest && out >= len)) {
+            break;
+        }
+
+        if (first == UTF_SUCCESS) {
+            first = error;
+        }
+
+        utf_utf8_check(s + i, n - i, &skip);
+        i += skip;
+
+        if (dest) {
+            dest[out] = UTF_REPLACEMENT_CHAR;
+        }
+        out++;
+    }
+
+    *src = (const char*)s + i;
+    utf_set_error(first);
+    return out;
+}
+
+size_t utf_mbsnrsanitize(char* dest, const char** src, size_t n, size_t len)
+{
+    const unsigned char* s;
+    size_t i = 0;
+    size_t out = 0;
+    size_t valid, skip, room;
+    int first = UTF_SUCCESS;
+    int error;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    s = (const unsigned char*)*src;
+
+    while (i < n) {
+        valid = i + utf_validate_prefix((const char*)s + i, n - i, &error);
+
+        if (dest) {
+            room = len - out;
+
+            if (valid - i > room) {
+                /* Only copy the runes that fit whole. */
+                valid = i + room;
+                while (valid > i && utf_utf8_is_cont(s[valid])) {
+                    valid--;
+                }
+                error = UTF_SUCCESS;
+            }
+
+            memcpy(dest + out, s + i, valid - i);
+        }
+
+        out += valid - i;
+        i = valid;
+
+        if (error == UTF_SUCCESS) {
+            break;
+        }
+
+        if (dest && len - out < 3) {
+            break;
+        }
+
+        if (first == UTF_SUCCESS) {
+            first = error;
+        }
+
+        utf_utf8_check(s + i, n - i, &skip);
+        i += skip;
+
+        if (dest) {
+            memcpy(dest + out, "\xEF\xBF\xBD", 3);
+        }
+        out += 3;
+    }
+
+    *src = (const char*)s + i;
+    utf_set_error(first);
+    return out;
+}
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Shuffles that keep the first 1, 2 or 3 bytes of each 32-bit lane and pack
+ * them together. They are indexed by the lane lengths less one, read as the
+ * digits of a base-3 number with lane 0 as the lowest digit.
+ */
+static const unsigned char utf_encode_pack[81][16] = {
+    { 0x00, 0x04, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x04, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0C, 0x0D, 0x0E, 0x80, 0x80, 0x80, 0x80 },
+};
+
+/* The bits of a 4-bit lane mask read as base-3 digits. */
+static const unsigned char utf_base3_bits[16] = {
+    0, 1, 3, 4, 9, 10, 12, 13, 27, 28, 30, 31, 36, 37, 39, 40
+};
+
+#define utf_select(m, a, b) \
+    _mm_or_si128(_mm_and_si128((m), (a)), _mm_andnot_si128((m), (b)))
+
+/* Return a mask of the lanes in v, which must all be below U+10000, that hold
+ * surrogates or non-characters. */
+__m128i utf_encode_invalid_bmp(__m128i v)
+{
+    return _mm_or_si128(_mm_or_si128(
+        _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF800)),
+                        _mm_set1_epi32(0xD800)),
+        _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(0xFDCF)),
+                      _mm_cmpgt_epi32(_mm_set1_epi32(0xFDF0), v))),
+        _mm_cmpgt_epi32(v, _mm_set1_epi32(0xFFFD)));
+}
+
+/* Encode the 4 runes in v, which must all be valid and below U+10000. Every
+ * lane is encoded as if it took 3 bytes, then as if it took 2, and the right
+ * form is picked before the unused bytes are packed away. 16 bytes are always
+ * stored at dest. Return the number of bytes that were encoded.
+ */
+size_t utf_encode_4(__m128i v, unsigned char* dest)
+{
+    __m128i six = _mm_set1_epi32(0x3F);
+    __m128i cont = _mm_set1_epi32(0x80);
+    __m128i is_2 = _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7F));
+    __m128i is_3 = _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7FF));
+    __m128i low, mid, two, three;
+    unsigned int m2, m3;
+
+    low = _mm_or_si128(_mm_and_si128(v, six), cont);
+    mid = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 6), six), cont);
+    two = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(v, 6), _mm_set1_epi32(0xC0)),
+        _mm_slli_epi32(low, 8));
+    three = _mm_or_si128(_mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(v, 12), _mm_set1_epi32(0xE0)),
+        _mm_slli_epi32(mid, 8)), _mm_slli_epi32(low, 16));
+
+    m2 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(is_2));
+    m3 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(is_3));
+
+    v = utf_select(is_3, three, utf_select(is_2, two, v));
+    v = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i*)(const void*)
+        utf_encode_pack[utf_base3_bits[m2] + utf_base3_bits[m3]]));
+    _mm_storeu_si128((__m128i*)(void*)dest, v);
+
+    return 4 + (size_t)utf_popcount(m2) + (size_t)utf_popcount(m3);
+}
+
+#undef utf_select
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+/* Encode the runes in src from *pos up to end into at most cap bytes at dest,
+ * or just count the bytes if dest is a null pointer, and advance *pos past the
+ * runes consumed. Runes are never split, and encoding stops in front of a rune
+ * that cannot be encoded, whose error is stored in *error. Return the number
+ * of bytes written.
+ */
+static size_t utf_encode_scalar(const utf_rune* src, size_t* pos, size_t end,
+                                unsigned char* dest, size_t cap, int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t n;
+    utf_rune r;
+
+    for (; i < end; i++) {
+        r = src[i];
+
+        if (r < 0x80) {
+            if (dest) {
+                if (out >= cap) {
+                    break;
+                }
+                dest[out] = (unsigned char)r;
+            }
+            out++;
+            continue;
+        }
+
+        *error = utf_utf8_check_rune(r);
+        if (*error != UTF_SUCCESS) {
+            break;
+        }
+
+        n = (r < 0x800) ? 2 : (r < 0x10000) ? 3 : 4;
+
+        if (dest) {
+            if (cap - out < n) {
+                break;
+            }
+            utf_utf8_encode(r, dest + out);
+        }
+        out += n;
+    }
+
+    *pos = i;
+    return out;
+}
+
+/* Encode the n runes in src from *pos into at most len bytes at dest, as
+ * utf_encode_scalar() does, with blocks of 16 runes handled by vector code
+ * when they are all ASCII or all in the BMP.
+ */
+static size_t utf_encode_utf8(const utf_rune* src, size_t* pos, size_t n,
+                              unsigned char* dest, size_t len, int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i a0, a1, a2, a3, any;
+    __m128i zero = _mm_setzero_si128();
+
+    *error = UTF_SUCCESS;
+
+    while (dest && sizeof(utf_rune) == 4 && n - i >= 16 && len - out >= 64) {
+        a0 = _mm_loadu_si128((const __m128i*)(const void*)(src + i));
+        a1 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 4));
+        a2 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 8));
+        a3 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 12));
+        any = _mm_or_si128(_mm_or_si128(a0, a1), _mm_or_si128(a2, a3));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(
+                any, _mm_set1_epi32(~0x7F)), zero)) == 0xFFFF) {
+            /* All ASCII, so narrowing with saturation is exact. */
+            _mm_storeu_si128((__m128i*)(void*)(dest + out), _mm_packus_epi16(
+                _mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3)));
+            i += 16;
+            out += 16;
+            continue;
+        }
+
+#  if defined(UTF_SIMD_LOOKUP)
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(
+                any, _mm_set1_epi32(~0xFFFF)), zero)) == 0xFFFF &&
+                !_mm_movemask_epi8(_mm_or_si128(
+                    _mm_or_si128(utf_encode_invalid_bmp(a0),
+                                 utf_encode_invalid_bmp(a1)),
+                    _mm_or_si128(utf_encode_invalid_bmp(a2),
+                                 utf_encode_invalid_bmp(a3))))) {
+            out += utf_encode_4(a0, dest + out);
+            out += utf_encode_4(a1, dest + out);
+            out += utf_encode_4(a2, dest + out);
+            out += utf_encode_4(a3, dest + out);
+            i += 16;
+            continue;
+        }
+#  endif
+
+        /* Supplementary runes, or runes that cannot be encoded. */
+        out += utf_encode_scalar(src, &i, i + 16, dest + out, len - out, error);
+        if (*error != UTF_SUCCESS) {
+            *pos = i;
+            return out;
+        }
+    }
+#else
+    *error = UTF_SUCCESS;
+#endif
+
+    out += utf_encode_scalar(src, &i, n, dest ? dest + out : 0, len - out,
+                             error);
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_utfsnrtombs(char* dest, const utf_rune** src, size_t n, size_t len)
+{
+    size_t i = 0;
+    size_t out;
+    int error;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    out = utf_encode_utf8(*src, &i, n, (unsigned char*)dest, len, &error);
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
+
+size_t utf_utfsrtombs(char* dest, const utf_rune** src, size_t len)
+{
+    size_t n = 0;
+    size_t out;
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    while ((*src)[n]) {
+        n++;
+    }
+
+    out = utf_utfsnrtombs(dest, src, n, len);
+
+    if (dest && out < len && !**src) {
+        dest[out] = '\0';
+    }
+
+    return out;
+}
+
+#if defined(UTF_SIMD_WIDTH)
+
+/* Return a mask of the lanes in v that hold runes that cannot be encoded: those
+ * out of range, including lanes that are negative as signed words, surrogates
+ * and non-characters. */
+static __m128i utf_encode_invalid(__m128i v)
+{
+    return _mm_or_si128(_mm_or_si128(
+        _mm_cmpgt_epi32(v, _mm_set1_epi32(0x10FFFF)),
+        _mm_cmpgt_epi32(_mm_setzero_si128(), v)), _mm_or_si128(
+        _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(~0x7FF)),
+                        _mm_set1_epi32(0xD800)), _mm_or_si128(
+        _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFE)),
+                        _mm_set1_epi32(0xFFFE)),
+        _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(0xFDCF)),
+                      _mm_cmpgt_epi32(_mm_set1_epi32(0xFDF0), v)))));
+}
+
+/* Return, in each lane, the number of bytes past the first that the rune in
+ * the same lane of v takes up when encoded. */
+static __m128i utf_encode_extra(__m128i v)
+{
+    return _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_setzero_si128(),
+        _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7F))),
+        _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7FF))),
+        _mm_cmpgt_epi32(v, _mm_set1_epi32(0xFFFF)));
+}
+
+#endif /* defined(UTF_SIMD_WIDTH) */
+
+/* Return the number of bytes that encoding the n runes in src from *pos takes,
+ * as utf_encode_utf8() counts them when dest is a null pointer, and advance
+ * *pos past the runes counted. Blocks of 16 valid runes are counted by vector
+ * code.
+ */
+static size_t utf_encode_length(const utf_rune* src, size_t* pos, size_t n,
+                                int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i a0, a1, a2, a3, sum;
+    unsigned int lanes[4];
+    size_t blocks;
+
+    while (sizeof(utf_rune) == 4 && n - i >= 16) {
+        /* A lane grows by at most 12 per block, so the sums are folded into
+         * out long before they can overflow. */
+        sum = _mm_setzero_si128();
+
+        for (blocks = 0; blocks < 4096 && n - i >= 16; blocks++) {
+            a0 = _mm_loadu_si128((const __m128i*)(const void*)(src + i));
+            a1 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 4));
+            a2 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 8));
+            a3 = _mm_loadu_si128((const __m128i*)(const void*)(src + i + 12));
+
+            if (_mm_movemask_epi8(_mm_or_si128(
+                    _mm_or_si128(utf_encode_invalid(a0),
+                                 utf_encode_invalid(a1)),
+                    _mm_or_si128(utf_encode_invalid(a2),
+                                 utf_encode_invalid(a3))))) {
+                break;
+            }
+
+            sum = _mm_add_epi32(sum, _mm_add_epi32(
+                _mm_add_epi32(utf_encode_extra(a0), utf_encode_extra(a1)),
+                _mm_add_epi32(utf_encode_extra(a2), utf_encode_extra(a3))));
+            i += 16;
+        }
+
+        _mm_storeu_si128((__m128i*)(void*)lanes, sum);
+        out += 16 * blocks + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+        if (blocks < 4096) {
+            /* The rest is shorter than a block or holds an invalid rune. */
+            break;
+        }
+    }
+#endif
+
+    out += utf_encode_scalar(src, &i, n, 0, 0, error);
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_utf8len(const utf_rune* s, size_t n)
+{
+    size_t i = 0;
+    size_t out;
+    int error;
+
+    if (!s) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    error = UTF_SUCCESS;
+    out = utf_encode_length(s, &i, n, &error);
+
+    utf_set_error(error);
+    return out;
+}
+
+size_t utf_utf16len_runes(const utf_rune* s, size_t n)
+{
+    size_t count = n;
+    size_t i = 0;
+#if defined(UTF_SIMD_WIDTH)
+    __m128i bias = _mm_set1_epi32(-0x7FFFFFFF - 1);
+    __m128i limit = _mm_set1_epi32(-0x7FFFFFFF - 1 + 0xFFFF);
+#endif
+
+    if (!s) {
+        return 0;
+    }
+
+#if defined(UTF_SIMD_WIDTH)
+    /* Biased by INT_MIN, the signed comparison orders runes as unsigned. Each
+     * rune above U+FFFF then sets two bits of the mask of the packed lanes. */
+    for (; sizeof(utf_rune) == 4 && n - i >= 8; i += 8) {
+        count += (size_t)utf_popcount((unsigned int)_mm_movemask_epi8(
+            _mm_packs_epi32(
+                _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(
+                    (const __m128i*)(const void*)(s + i)), bias), limit),
+                _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(
+                    (const __m128i*)(const void*)(s + i + 4)), bias),
+                    limit)))) / 2;
+    }
+#endif
+
+    for (; i < n; i++) {
+        count += s[i] > 0xFFFF;
+    }
+
+    return count;
+}
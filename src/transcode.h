@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_TRANSCODE_H
+#define UTF_TRANSCODE_H
+
+#include <stddef.h>
+
+#include <utf/utf.h>
+
+#include "simd.h"
+
+/* Decode the valid UTF-8 from *pos up to end into at most cap runes in dest,
+ * and advance *pos past the bytes consumed. Return the number of runes written.
+ */
+size_t utf_decode_valid(const unsigned char* s, size_t* pos, size_t end,
+                        utf_rune* dest, size_t cap);
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Decode the runes that start in the 16 bytes at s, which must be valid UTF-8
+ * with at least three more bytes after them. Return the number of runes
+ * written, which is at most 16.
+ */
+size_t utf_decode_16(const unsigned char* s, utf_rune* dest);
+
+/* Return a mask of the lanes in v, which must all be below U+10000, that hold
+ * surrogates or non-characters. */
+__m128i utf_encode_invalid_bmp(__m128i v);
+
+/* Encode the 4 runes in v, which must all be valid and below U+10000. 16 bytes
+ * are always stored at dest. Return the number of bytes that were encoded.
+ */
+size_t utf_encode_4(__m128i v, unsigned char* dest);
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+#endif /* UTF_TRANSCODE_H */
@@ -32,21 +32,56 @@ SPDX-License-Identifier: MIT
 
 #include <utf/utf.h>
 
-extern const utf_rune utf_ucd_alphabetic[131756];
-extern const utf_rune utf_ucd_blank[33];
-extern const utf_rune utf_ucd_control[2276];
-extern const utf_rune utf_ucd_currency[63];
-extern const utf_rune utf_ucd_digit[660];
-extern const utf_rune utf_ucd_integer[660];
-extern const utf_rune utf_ucd_lowercase[2227];
-extern const utf_rune utf_ucd_mathematic[948];
-extern const utf_rune utf_ucd_numeric[1791];
-extern const utf_rune utf_ucd_printable[142124];
-extern const utf_rune utf_ucd_punctuation[6221];
-extern const utf_rune utf_ucd_space[37];
-extern const utf_rune utf_ucd_symbol[7741];
-extern const utf_rune utf_ucd_titlecase[31];
-extern const utf_rune utf_ucd_uppercase[1831];
+/* A property record holds the UTF_CLASS_* mask of a rune in the bits below
+ * UTF_UCD_CATEGORY_SHIFT and its UTF_CATEGORY_* above them.
+ */
+#define UTF_UCD_CATEGORY_SHIFT 24
+#define UTF_UCD_CLASS_MASK 0xFFFFFF
+
+/* Return the value for r in the three-stage trie called name: stage 1 maps the
+ * top bits of r to a block of stage 2, which maps the middle bits to a leaf of
+ * values, indexed by the low bits of r. Stage 1 ends after the last block with
+ * a value other than 0, which is the value of every rune past it.
+ */
+#define utf_ucd_trie(name, r)                                                  \
+    ((r) >> 10 < sizeof(utf_ucd_##name##_stage1) /                             \
+                 sizeof(utf_ucd_##name##_stage1[0]) ?                          \
+        utf_ucd_##name##_leaves[(unsigned int)utf_ucd_##name##_stage2[         \
+            (unsigned int)utf_ucd_##name##_stage1[(r) >> 10] << 6 |            \
+            ((r) >> 4 & 0x3F)] << 4 | ((r) & 0xF)] : 0)
+
+/* Return the property record of r. Each distinct record is stored once in
+ * utf_ucd_records, and indexed by the record trie. Unassigned runes have the
+ * first.
+ */
+#define utf_ucd_record(r) (utf_ucd_records[utf_ucd_trie(record, r)])
+
+/* Return the property record of r like utf_ucd_record(), but with the runes
+ * below U+0100, which most text is made of, read straight from the flat
+ * utf_ucd_latin1 table instead of walking the trie.
+ */
+#define utf_ucd_lookup(r)                                                      \
+    ((r) < 0x100 ? utf_ucd_latin1[r] : utf_ucd_record(r))
+
+/* Return the rune that r maps to in the case whose deltas are in table. Each
+ * distinct set of upper, lower and title case deltas is stored once, and
+ * indexed by the casing trie. Runes without a mapping have the first, which
+ * maps them to themselves.
+ */
+#define utf_ucd_case(table, r)                                                 \
+    (((r) + table[utf_ucd_trie(casing, r)]) & UINT32_C(0xFFFFFFFF))
+
+extern const unsigned char utf_ucd_record_stage1[1088];
+extern const unsigned short utf_ucd_record_stage2[4160];
+extern const unsigned char utf_ucd_record_leaves[11072];
+extern const uint_least32_t utf_ucd_records[39];
+extern const uint_least32_t utf_ucd_latin1[256];
+extern const unsigned char utf_ucd_casing_stage1[123];
+extern const unsigned char utf_ucd_casing_stage2[1024];
+extern const unsigned char utf_ucd_casing_leaves[1808];
+extern const uint_least32_t utf_ucd_upper_deltas[179];
+extern const uint_least32_t utf_ucd_lower_deltas[179];
+extern const uint_least32_t utf_ucd_title_deltas[179];
 
 #endif /* UTF_UCD_H */
 
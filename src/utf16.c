@@ -0,0 +1,399 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "error.h"
+#include "simd.h"
+#include "transcode.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* Input is validated this many bytes at a time before it is converted, as in
+ * transcode.c. */
+#define UTF_CHUNK_SIZE 4096
+
+#define utf_swap16(u) ((utf_char16)(((u) >> 8 | (u) << 8) & 0xFFFF))
+
+/* Return whether code units in encoding have to be byte-swapped to or from the
+ * native byte order, or -1 if encoding is not a UTF-16 encoding. */
+static int utf_utf16_swap(int encoding)
+{
+    if (encoding == UTF_ENCODING_UTF16LE) {
+        return UTF_BIG_ENDIAN;
+    }
+
+    if (encoding == UTF_ENCODING_UTF16BE) {
+        return !UTF_BIG_ENDIAN;
+    }
+
+    return -1;
+}
+
+#if defined(UTF_SIMD_WIDTH)
+
+#define utf_swap16_vec(v) _mm_or_si128(_mm_slli_epi16((v), 8), \
+                                       _mm_srli_epi16((v), 8))
+
+#endif /* defined(UTF_SIMD_WIDTH) */
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Shuffles that narrow four runes below U+10000 to code units in native and in
+ * swapped byte order. */
+static const unsigned char utf_narrow_16[2][16] = {
+    { 0, 1, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 1, 0, 5, 4, 9, 8, 13, 12, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 }
+};
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+/* Store r, which must be a valid rune, as one or two code units at dest and
+ * return how many were stored. */
+static size_t utf_utf16_put(utf_rune r, utf_char16* dest, int swap)
+{
+    utf_char16 hi, lo;
+
+    if (r < 0x10000) {
+        lo = (utf_char16)r;
+        dest[0] = swap ? utf_swap16(lo) : lo;
+        return 1;
+    }
+
+    r -= 0x10000;
+    hi = (utf_char16)(0xD800 | (r >> 10));
+    lo = (utf_char16)(0xDC00 | (r & 0x3FF));
+    dest[0] = swap ? utf_swap16(hi) : hi;
+    dest[1] = swap ? utf_swap16(lo) : lo;
+    return 2;
+}
+
+/* Convert the valid UTF-8 from *pos up to end into at most cap code units in
+ * dest, and advance *pos past the bytes consumed. Surrogate pairs are never
+ * split. Return the number of code units written.
+ */
+static size_t utf_utf16_decode_valid(const unsigned char* s, size_t* pos,
+                                     size_t end, utf_char16* dest, size_t cap,
+                                     int swap)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t n;
+    utf_rune r;
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i zero = _mm_setzero_si128();
+    __m128i v;
+#  if defined(UTF_SIMD_LOOKUP)
+    __m128i narrow = _mm_loadu_si128(
+        (const __m128i*)(const void*)utf_narrow_16[swap]);
+    utf_rune runes[16];
+    size_t k, count;
+#  else
+    size_t stop;
+#  endif
+
+    while (end - i >= 32 && cap - out >= 32) {
+        v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+
+        if (!_mm_movemask_epi8(v)) {
+            /* Zero-extending ASCII to the high byte or to the low byte gives
+             * little or big-endian code units. */
+            if (swap == UTF_BIG_ENDIAN) {
+                _mm_storeu_si128((__m128i*)(void*)(dest + out),
+                                 _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128((__m128i*)(void*)(dest + out + 8),
+                                 _mm_unpackhi_epi8(v, zero));
+            } else {
+                _mm_storeu_si128((__m128i*)(void*)(dest + out),
+                                 _mm_unpacklo_epi8(zero, v));
+                _mm_storeu_si128((__m128i*)(void*)(dest + out + 8),
+                                 _mm_unpackhi_epi8(zero, v));
+            }
+            i += 16;
+            out += 16;
+            continue;
+        }
+
+#  if defined(UTF_SIMD_LOOKUP)
+        count = utf_decode_16(s + i, runes);
+        i += 16;
+
+        /* Skip the tail of a rune that started in the decoded bytes. */
+        while (utf_utf8_is_cont(s[i])) {
+            i++;
+        }
+
+        for (k = 0; k + 4 <= count; k += 4) {
+            v = _mm_loadu_si128((const __m128i*)(const void*)(runes + k));
+
+            if (_mm_movemask_epi8(_mm_cmpgt_epi32(v, _mm_set1_epi32(0xFFFF)))) {
+                out += utf_utf16_put(runes[k], dest + out, swap);
+                out += utf_utf16_put(runes[k + 1], dest + out, swap);
+                out += utf_utf16_put(runes[k + 2], dest + out, swap);
+                out += utf_utf16_put(runes[k + 3], dest + out, swap);
+                continue;
+            }
+
+            _mm_storel_epi64((__m128i*)(void*)(dest + out),
+                             _mm_shuffle_epi8(v, narrow));
+            out += 4;
+        }
+
+        for (; k < count; k++) {
+            out += utf_utf16_put(runes[k], dest + out, swap);
+        }
+#  else
+        for (stop = i + 16; i < stop; i += n) {
+            out += utf_utf16_put(utf_utf8_decode(s + i, &n), dest + out, swap);
+        }
+#  endif
+    }
+#endif
+
+    while (i < end && out < cap) {
+        r = utf_utf8_decode(s + i, &n);
+
+        if (r > 0xFFFF && cap - out < 2) {
+            break;
+        }
+
+        out += utf_utf16_put(r, dest + out, swap);
+        i += n;
+    }
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_mbsnrtoutf16(utf_char16* dest, const char** src, size_t n,
+                        size_t len, int encoding)
+{
+    const unsigned char* s;
+    size_t i = 0;
+    size_t out = 0;
+    size_t valid = 0;
+    size_t end;
+    int error = UTF_SUCCESS;
+    int swap = utf_utf16_swap(encoding);
+
+    if (swap < 0) {
+        utf_set_error(UTF_EVALUE);
+        return 0;
+    }
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    s = (const unsigned char*)*src;
+
+    while (i < n && (!dest || out < len)) {
+        end = (n - i > UTF_CHUNK_SIZE) ? i + UTF_CHUNK_SIZE : n;
+        valid = i + utf_validate_prefix((const char*)s + i, end - i, &error);
+
+        if (error == UTF_ETRUNC && end < n) {
+            /* Only the chunk was cut short, so the next one picks it up. */
+            error = UTF_SUCCESS;
+        }
+
+        if (dest) {
+            out += utf_utf16_decode_valid(s, &i, valid, dest + out, len - out,
+                                          swap);
+        } else {
+            out += utf_utf16len((const char*)s + i, valid - i);
+            i = valid;
+        }
+
+        if (error != UTF_SUCCESS || i < valid) {
+            break;
+        }
+    }
+
+    if (i < valid) {
+        /* Stopped early because dest is full. */
+        error = UTF_SUCCESS;
+    }
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
+
+/* Convert the code units in src from *pos up to end, of the n there are, into
+ * at most cap bytes of UTF-8 at dest, or just count the bytes if dest is a null
+ * pointer, and advance *pos past the code units consumed. A surrogate pair may
+ * run past end. Runes are never split, and conversion stops in front of a rune
+ * that cannot be converted, whose error is stored in *error. Return the number
+ * of bytes written.
+ */
+static size_t utf_utf16_encode_scalar(const utf_char16* src, size_t* pos,
+                                      size_t end, size_t n, unsigned char* dest,
+                                      size_t cap, int swap, int* error)
+{
+    size_t i = *pos;
+    size_t out = 0;
+    size_t units, bytes;
+    utf_char16 u, u2;
+    utf_rune r;
+
+    for (; i < end; i += units) {
+        u = swap ? utf_swap16(src[i]) : src[i];
+        units = 1;
+
+        if (u < 0x80) {
+            if (dest) {
+                if (out >= cap) {
+                    break;
+                }
+                dest[out] = (unsigned char)u;
+            }
+            out++;
+            continue;
+        }
+
+        r = u;
+
+        if ((u & 0xF800) == 0xD800) {
+            if (u >= 0xDC00) {
+                *error = UTF_ESEQ;
+                break;
+            }
+
+            if (i + 1 >= n) {
+                *error = UTF_ETRUNC;
+                break;
+            }
+
+            u2 = swap ? utf_swap16(src[i + 1]) : src[i + 1];
+            if ((u2 & 0xFC00) != 0xDC00) {
+                *error = UTF_ESEQ;
+                break;
+            }
+
+            r = 0x10000 + ((r - 0xD800) << 10) + (utf_rune)(u2 - 0xDC00);
+            units = 2;
+        }
+
+        *error = utf_utf8_check_rune(r);
+        if (*error != UTF_SUCCESS) {
+            break;
+        }
+
+        bytes = (r < 0x800) ? 2 : (r < 0x10000) ? 3 : 4;
+
+        if (dest) {
+            if (cap - out < bytes) {
+                break;
+            }
+            utf_utf8_encode(r, dest + out);
+        }
+        out += bytes;
+    }
+
+    *pos = i;
+    return out;
+}
+
+size_t utf_utf16snrtombs(char* dest, const utf_char16** src, size_t n,
+                         size_t len, int encoding)
+{
+    unsigned char* d = (unsigned char*)dest;
+    const utf_char16* s;
+    size_t i = 0;
+    size_t out = 0;
+    int error = UTF_SUCCESS;
+    int swap = utf_utf16_swap(encoding);
+
+#if defined(UTF_SIMD_WIDTH)
+    __m128i zero = _mm_setzero_si128();
+    __m128i v;
+#endif
+
+    if (swap < 0) {
+        utf_set_error(UTF_EVALUE);
+        return 0;
+    }
+
+    if (!src || !*src) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    s = *src;
+
+#if defined(UTF_SIMD_WIDTH)
+    while (d && n - i >= 8 && len - out >= 32) {
+        v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+        if (swap) {
+            v = utf_swap16_vec(v);
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+                _mm_and_si128(v, _mm_set1_epi16(~0x7F)), zero)) == 0xFFFF) {
+            _mm_storel_epi64((__m128i*)(void*)(d + out),
+                             _mm_packus_epi16(v, zero));
+            i += 8;
+            out += 8;
+            continue;
+        }
+
+#  if defined(UTF_SIMD_LOOKUP)
+        /* Without surrogates, the code units are the runes themselves. */
+        if (!_mm_movemask_epi8(_mm_or_si128(
+                utf_encode_invalid_bmp(_mm_unpacklo_epi16(v, zero)),
+                utf_encode_invalid_bmp(_mm_unpackhi_epi16(v, zero))))) {
+            out += utf_encode_4(_mm_unpacklo_epi16(v, zero), d + out);
+            out += utf_encode_4(_mm_unpackhi_epi16(v, zero), d + out);
+            i += 8;
+            continue;
+        }
+#  endif
+
+        out += utf_utf16_encode_scalar(s, &i, i + 8, n, d + out, len - out,
+                                       swap, &error);
+        if (error != UTF_SUCCESS) {
+            break;
+        }
+    }
+#endif
+
+    if (error == UTF_SUCCESS) {
+        out += utf_utf16_encode_scalar(s, &i, n, n, d ? d + out : 0, len - out,
+                                       swap, &error);
+    }
+
+    *src += i;
+    utf_set_error(error);
+    return out;
+}
@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "utf8.h"
+
+#define A { 1, 0x00, 0x00, UTF_SUCCESS } /* 0xxxxxxx */
+#define C { 0, 0x00, 0x00, UTF_ESTART }  /* 10xxxxxx */
+#define O { 0, 0x00, 0x00, UTF_ELEN }    /* C0, C1 */
+#define L2 { 2, 0x80, 0xBF, UTF_SUCCESS }
+#define L3 { 3, 0x80, 0xBF, UTF_SUCCESS }
+#define L4 { 4, 0x80, 0xBF, UTF_SUCCESS }
+#define E0 { 3, 0xA0, 0xBF, UTF_ELEN }   /* Overlong below U+0800 */
+#define ED { 3, 0x80, 0x9F, UTF_ESEQ }   /* Surrogates */
+#define F0 { 4, 0x90, 0xBF, UTF_ELEN }   /* Overlong below U+10000 */
+#define F4 { 4, 0x80, 0x8F, UTF_ELIMIT } /* Above U+10FFFF */
+#define X { 0, 0x00, 0x00, UTF_ELIMIT }  /* F5 to FD */
+#define V { 0, 0x00, 0x00, UTF_EVALUE }  /* FE, FF */
+
+const utf_utf8_lead_s utf_utf8_leads[256] = {
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,  A,
+    C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,
+    C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,
+    C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,
+    C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,  C,
+    O,  O,  L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2,
+    L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2, L2,
+    E0, L3, L3, L3, L3, L3, L3, L3, L3, L3, L3, L3, L3, ED, L3, L3,
+    F0, L4, L4, L4, F4, X,  X,  X,  X,  X,  X,  X,  X,  X,  V,  V,
+};
+
+#undef A
+#undef C
+#undef O
+#undef L2
+#undef L3
+#undef L4
+#undef E0
+#undef ED
+#undef F0
+#undef F4
+#undef X
+#undef V
@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_UTF8_H
+#define UTF_UTF8_H
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+/* Lead byte properties. len is the length of the sequence the byte starts, or
+ * 0 if it can never start one. A continuation byte following the lead that
+ * falls outside of [lo, hi] is reported as error, which is also the error for
+ * the lead byte itself when len is 0.
+ */
+typedef struct {
+    unsigned char len;
+    unsigned char lo;
+    unsigned char hi;
+    unsigned char error;
+} utf_utf8_lead_s;
+
+extern const utf_utf8_lead_s utf_utf8_leads[256];
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+#define utf_utf8_is_ascii(c) ((unsigned char)(c) <= UTF_ASCII_MAX)
+#define utf_utf8_is_cont(c) (((unsigned char)(c) & 0xC0) == 0x80)
+
+/* Return whether the well-formed sequence of len bytes at s encodes one of the
+ * non-characters rejected by utf_is_valid_rune(). */
+static inline bool utf_utf8_is_nonchar(const unsigned char* s, size_t len)
+{
+    if (len == 3) {
+        return s[0] == 0xEF &&
+            ((s[1] == 0xB7 && s[2] >= 0x90 && s[2] <= 0xAF) ||
+             (s[1] == 0xBF && s[2] >= 0xBE));
+    }
+
+    if (len == 4) {
+        return (s[1] & 0x0F) == 0x0F && s[2] == 0xBF && s[3] >= 0xBE;
+    }
+
+    return false;
+}
+
+/* Check the sequence at the start of s, which has avail > 0 bytes left. Return
+ * UTF_SUCCESS or the UTF_E* code for why it is malformed, and store in *n the
+ * length of the sequence, or of its maximal invalid subpart.
+ */
+static inline int utf_utf8_check(const unsigned char* s, size_t avail,
+                                 size_t* n)
+{
+    const utf_utf8_lead_s* lead = &utf_utf8_leads[s[0]];
+    size_t i;
+
+    *n = 1;
+
+    if (lead->len == 1) {
+        return UTF_SUCCESS;
+    }
+
+    if (lead->len == 0) {
+        return lead->error;
+    }
+
+    if (avail < 2) {
+        return UTF_ETRUNC;
+    }
+
+    if (s[1] < lead->lo || s[1] > lead->hi) {
+        return utf_utf8_is_cont(s[1]) ? lead->error : UTF_ESEQ;
+    }
+
+    for (i = 2; i < lead->len; i++) {
+        *n = i;
+
+        if (i >= avail) {
+            return UTF_ETRUNC;
+        }
+
+        if (!utf_utf8_is_cont(s[i])) {
+            return UTF_ESEQ;
+        }
+    }
+
+    *n = lead->len;
+
+    if (utf_utf8_is_nonchar(s, lead->len)) {
+        return UTF_ESEQ;
+    }
+
+    return UTF_SUCCESS;
+}
+
+/* Decode the well-formed sequence at the start of s and store its length in
+ * *n. The sequence must already have been validated.
+ */
+static inline utf_rune utf_utf8_decode(const unsigned char* s, size_t* n)
+{
+    if (s[0] < 0xC0) {
+        *n = 1;
+        return s[0];
+    }
+
+    if (s[0] < 0xE0) {
+        *n = 2;
+        return (utf_rune)(s[0] & 0x1F) << 6 | (utf_rune)(s[1] & 0x3F);
+    }
+
+    if (s[0] < 0xF0) {
+        *n = 3;
+        return (utf_rune)(s[0] & 0x0F) << 12 | (utf_rune)(s[1] & 0x3F) << 6 |
+            (utf_rune)(s[2] & 0x3F);
+    }
+
+    *n = 4;
+    return (utf_rune)(s[0] & 0x07) << 18 | (utf_rune)(s[1] & 0x3F) << 12 |
+        (utf_rune)(s[2] & 0x3F) << 6 | (utf_rune)(s[3] & 0x3F);
+}
+
+/* Return UTF_SUCCESS if r can be encoded, or the UTF_E* code that decoding
+ * its encoding would fail with.
+ */
+static inline int utf_utf8_check_rune(utf_rune r)
+{
+    if (r > UTF_MAX_VALUE) {
+        return UTF_ELIMIT;
+    }
+
+    if ((r & 0xFFFFF800U) == 0xD800 || (r - 0xFDD0U) < 0x20 ||
+            (r & 0xFFFEU) == 0xFFFE) {
+        return UTF_ESEQ;
+    }
+
+    return UTF_SUCCESS;
+}
+
+/* Encode r, which must be from U+0080 to U+07FF, as two bytes at s. */
+static inline void utf_utf8_encode_2(utf_rune r, unsigned char* s)
+{
+    s[0] = (unsigned char)(0xC0 | ((r & 0x7C0) >> 6));
+    s[1] = (unsigned char)(0x80 | (r & 0x3F));
+}
+
+/* Encode r, which must pass utf_utf8_check_rune(), at the start of s and
+ * return the number of bytes written.
+ */
+static inline size_t utf_utf8_encode(utf_rune r, unsigned char* s)
+{
+    if (r < 0x80) {
+        s[0] = (unsigned char)r;
+        return 1;
+    }
+
+    if (r < 0x800) {
+        utf_utf8_encode_2(r, s);
+        return 2;
+    }
+
+    if (r < 0x10000) {
+        s[0] = (unsigned char)(0xE0 | (r >> 12));
+        s[1] = (unsigned char)(0x80 | ((r >> 6) & 0x3F));
+        s[2] = (unsigned char)(0x80 | (r & 0x3F));
+        return 3;
+    }
+
+    s[0] = (unsigned char)(0xF0 | (r >> 18));
+    s[1] = (unsigned char)(0x80 | ((r >> 12) & 0x3F));
+    s[2] = (unsigned char)(0x80 | ((r >> 6) & 0x3F));
+    s[3] = (unsigned char)(0x80 | (r & 0x3F));
+    return 4;
+}
+
+#pragma clang diagnostic pop
+
+#endif /* UTF_UTF8_H */
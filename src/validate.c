@@ -0,0 +1,510 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "bit_math.h"
+#include "simd.h"
+#include "utf8.h"
+#include "validate.h"
+
+#pragma clang diagnostic ignored "-Wc99-extensions"
+
+/* The high bit of every byte in an unsigned long. */
+#define UTF_WORD_HIGH_BITS ((~0UL / 0xFFUL) * 0x80UL)
+
+/* Validate s from offset i up to the first rune boundary at or after stop.
+ * Return that boundary, or the offset of the first malformed sequence with its
+ * code stored in *error.
+ */
+static size_t utf_validate_scalar(const unsigned char* s, size_t i,
+                                  size_t stop, size_t len, int* error)
+{
+    unsigned long word;
+    size_t n;
+
+    while (i < stop) {
+        if (stop - i >= sizeof(word)) {
+            memcpy(&word, s + i, sizeof(word));
+            if (!(word & UTF_WORD_HIGH_BITS)) {
+                i += sizeof(word);
+                continue;
+            }
+        }
+
+        if (utf_utf8_is_ascii(s[i])) {
+            i++;
+            continue;
+        }
+
+        *error = utf_utf8_check(s + i, len - i, &n);
+        if (*error != UTF_SUCCESS) {
+            return i;
+        }
+
+        i += n;
+    }
+
+    return i;
+}
+
+/* Return the number of runes that start from offset i up to end, which is the
+ * number of bytes that are not continuation bytes.
+ */
+static size_t utf_count_leads(const unsigned char* s, size_t i, size_t end)
+{
+    unsigned long word, conts;
+    size_t count = 0;
+
+    for (; end - i >= sizeof(word); i += sizeof(word)) {
+        memcpy(&word, s + i, sizeof(word));
+
+        /* 10xxxxxx bytes keep their high bit, which is then summed across the
+         * word by the multiplication. */
+        conts = (word & ~(word << 1) & UTF_WORD_HIGH_BITS) >> 7;
+        count += sizeof(word) -
+            (size_t)((conts * (~0UL / 0xFFUL)) >> (8 * (sizeof(word) - 1)));
+    }
+
+    for (; i < end; i++) {
+        count += !utf_utf8_is_cont(s[i]);
+    }
+
+    return count;
+}
+
+/* Return the number of runes before offset pos, given that counted runes start
+ * before offset at.
+ */
+static size_t utf_count_adjust(const unsigned char* s, size_t counted,
+                               size_t at, size_t pos)
+{
+    if (pos >= at) {
+        return counted + utf_count_leads(s, at, pos);
+    }
+
+    return counted - utf_count_leads(s, pos, at);
+}
+
+#if defined(UTF_SIMD_WIDTH)
+
+#define UTF_SIMD_BLOCK (2 * UTF_SIMD_WIDTH)
+
+/* Return the start of the rune that is still open at offset i, or i itself if
+ * every rune before it is complete. A lead byte just before i has not been
+ * paired with its successor yet, so it is returned as well if it is invalid.
+ */
+static size_t utf_validate_resume(const unsigned char* s, size_t i)
+{
+    size_t k;
+
+    for (k = 1; k <= 3 && k <= i; k++) {
+        if (!utf_utf8_is_cont(s[i - k])) {
+            if (utf_utf8_leads[s[i - k]].len > k ||
+                    utf_utf8_leads[s[i - k]].len == 0) {
+                return i - k;
+            }
+            break;
+        }
+    }
+
+    return i;
+}
+
+#if defined(UTF_SIMD_LOOKUP)
+
+/* Error classes of the lookup algorithm from Keiser and Lemire, "Validating
+ * UTF-8 In Less Than One Instruction Per Byte". Every pair of adjacent bytes is
+ * looked up in three nibble tables, and any class present in all three lookups
+ * is an error. TWO_CONTS is expected exactly where the byte must be the third
+ * or fourth of a sequence, so it is toggled by that condition instead.
+ */
+#define UTF_TOO_SHORT      0x01 /* 11xxxxxx 0xxxxxxx, 11xxxxxx 11xxxxxx */
+#define UTF_TOO_LONG       0x02 /* 0xxxxxxx 10xxxxxx */
+#define UTF_OVERLONG_3     0x04 /* 11100000 100xxxxx */
+#define UTF_TOO_LARGE      0x08 /* 11110100 1001xxxx, 11110100 101xxxxx */
+#define UTF_SURROGATE      0x10 /* 11101101 101xxxxx */
+#define UTF_OVERLONG_2     0x20 /* 1100000x 10xxxxxx */
+#define UTF_TOO_LARGE_1000 0x40 /* 11110101+ 1000xxxx */
+#define UTF_OVERLONG_4     0x40 /* 11110000 1000xxxx */
+#define UTF_TWO_CONTS      0x80 /* 10xxxxxx 10xxxxxx */
+#define UTF_CARRY          (UTF_TOO_SHORT | UTF_TOO_LONG | UTF_TWO_CONTS)
+
+/* Indexed by the high nibble of the first byte. */
+static const unsigned char utf_byte_1_high[16] = {
+    UTF_TOO_LONG, UTF_TOO_LONG, UTF_TOO_LONG, UTF_TOO_LONG,
+    UTF_TOO_LONG, UTF_TOO_LONG, UTF_TOO_LONG, UTF_TOO_LONG,
+    UTF_TWO_CONTS, UTF_TWO_CONTS, UTF_TWO_CONTS, UTF_TWO_CONTS,
+    UTF_TOO_SHORT | UTF_OVERLONG_2,
+    UTF_TOO_SHORT,
+    UTF_TOO_SHORT | UTF_OVERLONG_3 | UTF_SURROGATE,
+    UTF_TOO_SHORT | UTF_TOO_LARGE | UTF_TOO_LARGE_1000 | UTF_OVERLONG_4
+};
+
+/* Indexed by the low nibble of the first byte. */
+static const unsigned char utf_byte_1_low[16] = {
+    UTF_CARRY | UTF_OVERLONG_3 | UTF_OVERLONG_2 | UTF_OVERLONG_4,
+    UTF_CARRY | UTF_OVERLONG_2,
+    UTF_CARRY,
+    UTF_CARRY,
+    UTF_CARRY | UTF_TOO_LARGE,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000 | UTF_SURROGATE,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000,
+    UTF_CARRY | UTF_TOO_LARGE | UTF_TOO_LARGE_1000
+};
+
+/* Indexed by the high nibble of the second byte. */
+static const unsigned char utf_byte_2_high[16] = {
+    UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT,
+    UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT,
+    UTF_TOO_LONG | UTF_OVERLONG_2 | UTF_TWO_CONTS | UTF_OVERLONG_3 |
+        UTF_TOO_LARGE_1000 | UTF_OVERLONG_4,
+    UTF_TOO_LONG | UTF_OVERLONG_2 | UTF_TWO_CONTS | UTF_OVERLONG_3 |
+        UTF_TOO_LARGE,
+    UTF_TOO_LONG | UTF_OVERLONG_2 | UTF_TWO_CONTS | UTF_SURROGATE |
+        UTF_TOO_LARGE,
+    UTF_TOO_LONG | UTF_OVERLONG_2 | UTF_TWO_CONTS | UTF_SURROGATE |
+        UTF_TOO_LARGE,
+    UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT, UTF_TOO_SHORT
+};
+
+/* Return a vector that is non-zero wherever input, preceded by prev_input, is
+ * either malformed or might end a non-character. Non-characters are well-formed
+ * UTF-8, so they are only flagged here and left for the scalar check.
+ */
+static inline utf_vec utf_validate_vec(utf_vec input, utf_vec prev_input)
+{
+    utf_vec nibble = utf_vec_set1(0x0F);
+    utf_vec prev1 = utf_vec_prev(input, prev_input, 1);
+    utf_vec prev2 = utf_vec_prev(input, prev_input, 2);
+    utf_vec prev3 = utf_vec_prev(input, prev_input, 3);
+    utf_vec special, must_cont, nonchar;
+
+    special = utf_vec_and(
+        utf_vec_and(
+            utf_vec_lookup(utf_vec_table(utf_byte_1_high),
+                           utf_vec_and(utf_vec_shr4(prev1), nibble)),
+            utf_vec_lookup(utf_vec_table(utf_byte_1_low),
+                           utf_vec_and(prev1, nibble))),
+        utf_vec_lookup(utf_vec_table(utf_byte_2_high),
+                       utf_vec_and(utf_vec_shr4(input), nibble)));
+
+    must_cont = utf_vec_and(
+        utf_vec_or(utf_vec_subs(prev2, utf_vec_set1(0xE0 - 0x80)),
+                   utf_vec_subs(prev3, utf_vec_set1(0xF0 - 0x80))),
+        utf_vec_set1(0x80));
+
+    /* xxBF BE, xxBF BF, and EF B7 xx */
+    nonchar = utf_vec_or(
+        utf_vec_and(utf_vec_eq(prev1, utf_vec_set1(0xBF)),
+                    utf_vec_eq(utf_vec_and(input, utf_vec_set1(0xFE)),
+                               utf_vec_set1(0xBE))),
+        utf_vec_and(utf_vec_eq(prev1, utf_vec_set1(0xB7)),
+                    utf_vec_eq(prev2, utf_vec_set1(0xEF))));
+
+    return utf_vec_or(utf_vec_xor(must_cont, special), nonchar);
+}
+
+#endif /* defined(UTF_SIMD_LOOKUP) */
+
+/* Validate s in blocks of UTF_SIMD_BLOCK bytes for as long as whole blocks
+ * remain. Blocks that are flagged by the vector check are handed to
+ * utf_validate_scalar(), which finds the exact error, if any. Return the rune
+ * boundary where validation stopped, or the offset of the first malformed
+ * sequence with its code stored in *error. Unless count is a null pointer, the
+ * number of runes before the returned offset is stored in it.
+ */
+static size_t utf_validate_simd(const unsigned char* s, size_t len, int* error,
+                                size_t* count)
+{
+    utf_vec in0, in1;
+#if defined(UTF_SIMD_LOOKUP)
+    utf_vec prev = utf_vec_zero();
+#endif
+    bool pending = false;
+    bool flagged;
+    size_t counted = 0;
+    size_t i = 0;
+    size_t next;
+
+    while (len - i >= UTF_SIMD_BLOCK) {
+        in0 = utf_vec_load(s + i);
+        in1 = utf_vec_load(s + i + UTF_SIMD_WIDTH);
+
+        if (count) {
+            counted += (size_t)utf_popcount(utf_vec_leads(in0)) +
+                (size_t)utf_popcount(utf_vec_leads(in1));
+        }
+
+        if (!utf_vec_mask(utf_vec_or(in0, in1))) {
+            /* All ASCII, which is only an error if a rune is still open. */
+            flagged = pending;
+        } else {
+#if defined(UTF_SIMD_LOOKUP)
+            flagged = utf_vec_any(utf_vec_or(utf_validate_vec(in0, prev),
+                                             utf_validate_vec(in1, in0)));
+#else
+            flagged = true;
+#endif
+        }
+
+        if (flagged) {
+            next = utf_validate_scalar(s, utf_validate_resume(s, i),
+                                       i + UTF_SIMD_BLOCK, len, error);
+            if (*error != UTF_SUCCESS) {
+                if (count) {
+                    *count = utf_count_adjust(s, counted, i + UTF_SIMD_BLOCK,
+                                              next);
+                }
+                return next;
+            }
+
+            /* Anything past the block is the tail of a rune counted in it. */
+            i = next;
+#if defined(UTF_SIMD_LOOKUP)
+            prev = utf_vec_zero();
+#endif
+            pending = false;
+            continue;
+        }
+
+        i += UTF_SIMD_BLOCK;
+#if defined(UTF_SIMD_LOOKUP)
+        prev = in1;
+#endif
+        pending = s[i - 1] >= 0xC0 || s[i - 2] >= 0xE0 || s[i - 3] >= 0xF0;
+    }
+
+    next = utf_validate_resume(s, i);
+    if (count) {
+        *count = utf_count_adjust(s, counted, i, next);
+    }
+
+    return next;
+}
+
+#endif /* defined(UTF_SIMD_WIDTH) */
+
+size_t utf_validate_count(const char* s, size_t len, int* error,
+                          size_t* count)
+{
+    const unsigned char* p = (const unsigned char*)s;
+    size_t counted = 0;
+    size_t i = 0;
+    size_t end;
+
+    *error = UTF_SUCCESS;
+
+#if defined(UTF_SIMD_WIDTH)
+    i = utf_validate_simd(p, len, error, count ? &counted : 0);
+    if (*error != UTF_SUCCESS) {
+        if (count) {
+            *count = counted;
+        }
+        return i;
+    }
+#endif
+
+    end = utf_validate_scalar(p, i, len, len, error);
+    if (count) {
+        *count = counted + utf_count_leads(p, i, end);
+    }
+
+    return end;
+}
+
+size_t utf_validate_prefix(const char* s, size_t len, int* error)
+{
+    return utf_validate_count(s, len, error, 0);
+}
+
+bool utf_validstring(const char* s, size_t len)
+{
+    int error;
+
+    if (!s) {
+        return false;
+    }
+
+    return utf_validate_prefix(s, len, &error) == len;
+}
+
+bool utf_validate_ex(const char* s, size_t len, utf_validation_s* result)
+{
+    assert(result);
+
+    result->offset = 0;
+    result->runes = 0;
+    result->error = UTF_EVALUE;
+
+    if (!s) {
+        return false;
+    }
+
+    result->offset = utf_validate_count(s, len, &result->error,
+                                        &result->runes);
+
+    return result->error == UTF_SUCCESS;
+}
+
+size_t utf_runecount(const char* s, size_t len)
+{
+    const unsigned char* p = (const unsigned char*)s;
+    size_t count = 0;
+    size_t i = 0;
+
+    if (!s) {
+        return 0;
+    }
+
+#if defined(UTF_SIMD_WIDTH)
+    for (; len - i >= UTF_SIMD_BLOCK; i += UTF_SIMD_BLOCK) {
+        count += (size_t)utf_popcount(utf_vec_leads(utf_vec_load(p + i))) +
+            (size_t)utf_popcount(utf_vec_leads(
+                utf_vec_load(p + i + UTF_SIMD_WIDTH)));
+    }
+#endif
+
+    return count + utf_count_leads(p, i, len);
+}
+
+size_t utf_utf16len(const char* s, size_t len)
+{
+    const unsigned char* p = (const unsigned char*)s;
+    size_t count = 0;
+    size_t i = 0;
+#if defined(UTF_SIMD_WIDTH)
+    utf_vec v;
+#endif
+
+    if (!s) {
+        return 0;
+    }
+
+#if defined(UTF_SIMD_WIDTH)
+    /* Every rune takes a unit, and those with a four-byte lead take two. Lead
+     * bytes F0 to FF are the negative bytes above (char)0xEF. */
+    for (; len - i >= UTF_SIMD_WIDTH; i += UTF_SIMD_WIDTH) {
+        v = utf_vec_load(p + i);
+        count += (size_t)utf_popcount(utf_vec_leads(v)) +
+            (size_t)utf_popcount(utf_vec_mask(utf_vec_and(
+                utf_vec_gt(v, utf_vec_set1(0xEF)),
+                utf_vec_gt(utf_vec_zero(), v))));
+    }
+#endif
+
+    count += utf_count_leads(p, i, len);
+
+    for (; i < len; i++) {
+        count += p[i] >= 0xF0;
+    }
+
+    return count;
+}
+
+bool utf_runecount_valid(const char* s, size_t len, size_t* count)
+{
+    size_t counted = 0;
+    bool valid = false;
+    int error;
+
+    if (s) {
+        valid = utf_validate_count(s, len, &error, &counted) == len;
+    }
+
+    if (count) {
+        *count = counted;
+    }
+
+    return valid;
+}
+
+int utf_runenlen(const char* s, size_t len)
+{
+    const unsigned char* p = (const unsigned char*)s;
+    size_t count = 0;
+    size_t i = 0;
+#if defined(UTF_SIMD_WIDTH)
+    utf_vec block;
+    size_t leads;
+#endif
+
+    if (!s) {
+        return 0;
+    }
+
+#if defined(UTF_SIMD_WIDTH)
+    /* Blocks are only read from aligned addresses, so one that holds the
+     * terminating NUL never reaches into the next page. */
+    for (; p[i] && (size_t)(const void*)(p + i) % UTF_SIMD_WIDTH != 0; i++) {
+        if (!utf_utf8_is_cont(p[i])) {
+            if (count == len) {
+                break;
+            }
+            count++;
+        }
+    }
+
+    if ((size_t)(const void*)(p + i) % UTF_SIMD_WIDTH == 0) {
+        for (;; i += UTF_SIMD_WIDTH) {
+            block = utf_vec_load(p + i);
+            if (utf_vec_mask(utf_vec_eq(block, utf_vec_zero()))) {
+                break;
+            }
+            leads = (size_t)utf_popcount(utf_vec_leads(block));
+            if (count + leads > len) {
+                /* The rune after the last one wanted starts in here. */
+                break;
+            }
+            count += leads;
+        }
+    }
+#endif
+
+    for (; p[i]; i++) {
+        if (!utf_utf8_is_cont(p[i])) {
+            if (count == len) {
+                break;
+            }
+            count++;
+        }
+    }
+
+    return (i > INT_MAX) ? INT_MAX : (int)i;
+}
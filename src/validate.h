@@ -0,0 +1,45 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef UTF_VALIDATE_H
+#define UTF_VALIDATE_H
+
+#include <stddef.h>
+
+/* Return the offset of the first malformed sequence in the len bytes at s, or
+ * len if there is none. The UTF_E* code for the sequence is stored in *error.
+ */
+size_t utf_validate_prefix(const char* s, size_t len, int* error);
+
+/* Identical to utf_validate_prefix(), except that unless count is a null
+ * pointer, the number of runes before the returned offset is stored in it. The
+ * runes are counted in the same pass over s.
+ */
+size_t utf_validate_count(const char* s, size_t len, int* error,
+                          size_t* count);
+
+#endif /* UTF_VALIDATE_H */
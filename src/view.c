@@ -0,0 +1,209 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include <utf/platform.h>
+#include <utf/utf.h>
+
+#include "alloc.h"
+#include "bit_math.h"
+#include "error.h"
+#include "simd.h"
+#include "validate.h"
+
+/* A conversion between two byte encodings, with the same interface as
+ * utf_mbsnrsanitize().
+ */
+typedef size_t (*utf_view_convert_fn)(char*, const char**, size_t, size_t);
+
+/* Return the offset of the first of the n bytes at s that is at least min, or
+ * that is a null byte if nul is set, or n if there is none.
+ */
+static size_t utf_view_span(const unsigned char* s, size_t n, unsigned char min,
+                            int nul)
+{
+    size_t i = 0;
+#if defined(UTF_SIMD_WIDTH)
+    utf_vec v, hit;
+    unsigned int mask;
+
+    for (; n - i >= UTF_SIMD_WIDTH; i += UTF_SIMD_WIDTH) {
+        v = utf_vec_load(s + i);
+        hit = utf_vec_eq(utf_vec_max(v, utf_vec_set1(min)), v);
+        if (nul) {
+            hit = utf_vec_or(hit, utf_vec_eq(v, utf_vec_zero()));
+        }
+
+        mask = utf_vec_mask(hit);
+        if (mask) {
+            return i + (size_t)utf_popcount((mask & (0U - mask)) - 1);
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        if (s[i] >= min || (nul && !s[i])) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* Return the length of the prefix of the n bytes at s that the conversion from
+ * from to to leaves unchanged, and store the function that converts the rest
+ * in *convert. Return n and leave *convert alone if the conversion is not
+ * supported.
+ */
+static size_t utf_view_prefix(const char* s, size_t n, int from, int to,
+                              utf_view_convert_fn* convert)
+{
+    const unsigned char* u = (const unsigned char*)s;
+    size_t valid;
+    int error;
+
+    if (from == UTF_ENCODING_LATIN1 && to == UTF_ENCODING_UTF8) {
+        *convert = utf_latin1_to_utf8;
+        return utf_view_span(u, n, 0x80, 0);
+    }
+
+    if (from == UTF_ENCODING_UTF8 && to == UTF_ENCODING_LATIN1) {
+        *convert = utf_utf8_to_latin1;
+        return utf_view_span(u, n, 0x80, 0);
+    }
+
+    /* The rest leave valid UTF-8 alone up to the first supplementary rune,
+     * and Modified UTF-8 up to the first null rune as well. */
+    if (from == UTF_ENCODING_UTF8 && to == UTF_ENCODING_UTF8) {
+        *convert = utf_mbsnrsanitize;
+    } else if (from == UTF_ENCODING_CESU8 && to == UTF_ENCODING_UTF8) {
+        *convert = utf_cesu8_to_utf8;
+    } else if (from == UTF_ENCODING_MUTF8 && to == UTF_ENCODING_UTF8) {
+        *convert = utf_mutf8_to_utf8;
+    } else if (from == UTF_ENCODING_UTF8 && to == UTF_ENCODING_CESU8) {
+        *convert = utf_utf8_to_cesu8;
+    } else if (from == UTF_ENCODING_UTF8 && to == UTF_ENCODING_MUTF8) {
+        *convert = utf_utf8_to_mutf8;
+    } else {
+        return n;
+    }
+
+    valid = utf_validate_prefix(s, n, &error);
+
+    if (to == UTF_ENCODING_UTF8 && from == UTF_ENCODING_UTF8) {
+        return valid;
+    }
+
+    return utf_view_span(u, valid, 0xF0, to == UTF_ENCODING_MUTF8);
+}
+
+int utf_convert_view(const char* s, size_t n, int from, int to,
+                     utf_view_s* view)
+{
+    return utf_convert_view_with(s, n, from, to, view, 0);
+}
+
+int utf_convert_view_with(const char* s, size_t n, int from, int to,
+                          utf_view_s* view, const utf_allocator_s* allocator)
+{
+    utf_view_convert_fn convert = 0;
+    const char* p;
+    size_t prefix, count;
+    int error;
+
+    if (!view) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    view->data = s;
+    view->len = 0;
+    view->consumed = 0;
+    view->owned = 0;
+    view->allocator = *utf_allocator(allocator);
+
+    if (!s) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    prefix = utf_view_prefix(s, n, from, to, &convert);
+    if (!convert) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    view->len = prefix;
+    view->consumed = prefix;
+
+    if (prefix == n) {
+        utf_set_error(UTF_SUCCESS);
+        return 0;
+    }
+
+    /* Size the rest exactly before anything is copied. */
+    p = s + prefix;
+    count = convert(0, &p, n - prefix, 0);
+    error = utf_errno;
+
+    if (count > 0) {
+        view->owned = (char*)utf_alloc(&view->allocator, prefix + count);
+        if (!view->owned) {
+            view->len = 0;
+            errno = ENOMEM;
+            return -1;
+        }
+
+        memcpy(view->owned, s, prefix);
+        p = s + prefix;
+        convert(view->owned + prefix, &p, n - prefix, count);
+
+        view->data = view->owned;
+        view->len = prefix + count;
+    }
+
+    /* Nothing is written past the prefix when the rest starts with an error
+     * that stops the conversion, so the prefix is still borrowed. */
+    view->consumed = (size_t)(p - s);
+    utf_set_error(error);
+    return 0;
+}
+
+void utf_view_release(utf_view_s* view)
+{
+    if (!view) {
+        return;
+    }
+
+    utf_free(&view->allocator, view->owned, view->len);
+    view->data = 0;
+    view->len = 0;
+    view->consumed = 0;
+    view->owned = 0;
+}
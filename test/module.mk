@@ -3,7 +3,7 @@ CUR_LIST_DIR     := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
 -include $(EXT_SRCDIR)/unity.mk
 LIST_DIR     := $(CUR_LIST_DIR)
 
-TEST_SRCS    := test_decode.c test_encode.c test_properties.c
+TEST_SRCS    := test_decode.c test_encode.c test_properties.c test_validate.c
 
 TEST_SRCS    := $(addprefix $(LIST_DIR)/,$(TEST_SRCS))
 TEST_OBJS    := $(addprefix $(OBJDIR)/,$(TEST_SRCS:.c=.o))
@@ -38,6 +38,10 @@ $(TEST_OBJDIR)/test_properties$(EXEEXT): $(TEST_OBJDIR)/test_properties.o
 	$(CC) $(CFLAGS) $(LINKFLAGS) -pie -rdynamic -o $@ $< \
 		$(TESTDEP_OBJS) $(UNITY_OBJS)
 
+$(TEST_OBJDIR)/test_validate$(EXEEXT): $(TEST_OBJDIR)/test_validate.o
+	$(CC) $(CFLAGS) $(LINKFLAGS) -pie -rdynamic -o $@ $< \
+		$(TESTDEP_OBJS) $(UNITY_OBJS)
+
 tests: DEPS := $(TEST_OBJS:.o=.d) $(TESTDEP_OBJS:.o=.d) $(UNITY_OBJS:.o=.d)
 tests: all $(TEST_BINS)
 
@@ -26,6 +26,7 @@ SPDX-License-Identifier: MIT
 */
 
 #include <utf/utf.h>
+#include <utf/inline.h>
 
 #include "unity.h"
 #include "util.h"
@@ -874,6 +875,688 @@ void test_decode_problematic_nonchar(void)
     free(seq3);
 }
 
+void test_decode_mbsnrtoufs_kosme(void)
+{
+    utf_rune dest[8] = {0};
+    const char* kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
+    const char* src = kosme;
+    size_t n;
+
+    utf_errno = -1;
+    n = utf_mbsnrtoufs(dest, &src, 11, 8);
+
+    TEST_ASSERT_EQUAL_MESSAGE(5, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(11, src - kosme, "Has an incorrect number of bytes consumed");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_SUCCESS, utf_errno, "Decode unexpectedly failed");
+    TEST_ASSERT_EQUAL_HEX32(0x03BA, dest[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x1F79, dest[1]);
+    TEST_ASSERT_EQUAL_HEX32(0x03C3, dest[2]);
+    TEST_ASSERT_EQUAL_HEX32(0x03BC, dest[3]);
+    TEST_ASSERT_EQUAL_HEX32(0x03B5, dest[4]);
+    TEST_ASSERT_EQUAL_HEX32(0, dest[5]);
+}
+
+void test_decode_mbsnrtoufs_long(void)
+{
+    utf_rune dest[300] = {0};
+    char src[300];
+    const char* p = src;
+    size_t i, n;
+
+    /* Long enough for the vector paths, with a 3-byte rune every 20 bytes. */
+    for (i = 0; i + 3 <= sizeof(src); i += 20) {
+        memset(&src[i], 'a' + (int)(i % 26), 17);
+        memcpy(&src[i + 17], "\xe2\x82\xac", 3);
+    }
+
+    n = utf_mbsnrtoufs(dest, &p, sizeof(src), 300);
+
+    TEST_ASSERT_EQUAL_MESSAGE(270, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(sizeof(src), p - src, "Has an incorrect number of bytes consumed");
+
+    for (i = 0; i < n; i++) {
+        if (i % 18 == 17) {
+            TEST_ASSERT_EQUAL_HEX32(0x20AC, dest[i]);
+        } else {
+            TEST_ASSERT_EQUAL_HEX32('a' + (i / 18 * 20) % 26, dest[i]);
+        }
+    }
+}
+
+void test_decode_mbsnrtoufs_stops(void)
+{
+    utf_rune dest[8] = {0};
+    const char* seq = "ab\xce\xba\xed\xa0\x80" "cd";
+    const char* src = seq;
+    size_t n;
+
+    /* Stops in front of the surrogate. */
+    utf_errno = 0;
+    n = utf_mbsnrtoufs(dest, &src, 9, 8);
+    TEST_ASSERT_EQUAL_MESSAGE(3, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(4, src - seq, "Did not stop at the malformed sequence");
+    TEST_ASSERT_MESSAGE(utf_errno, "Decode unexpectedly succeeded");
+
+    /* Stops when dest is full, which is not an error. */
+    src = seq;
+    utf_errno = -1;
+    n = utf_mbsnrtoufs(dest, &src, 9, 2);
+    TEST_ASSERT_EQUAL_MESSAGE(2, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(2, src - seq, "Did not stop at a full buffer");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_SUCCESS, utf_errno, "Decode unexpectedly failed");
+
+    /* Counts without writing when dest is a null pointer. */
+    src = seq;
+    n = utf_mbsnrtoufs(0, &src, 4, 0);
+    TEST_ASSERT_EQUAL_MESSAGE(3, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(4, src - seq, "Has an incorrect number of bytes consumed");
+}
+
+void test_decode_mbsrtoufs(void)
+{
+    utf_rune dest[4] = { 1, 1, 1, 1 };
+    const char* str = "a\xce\xba";
+    const char* src = str;
+    size_t n;
+
+    n = utf_mbsrtoufs(dest, &src, 4);
+
+    TEST_ASSERT_EQUAL_MESSAGE(2, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(3, src - str, "Has an incorrect number of bytes consumed");
+    TEST_ASSERT_EQUAL_HEX32('a', dest[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x03BA, dest[1]);
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0, dest[2], "Missing the null rune");
+    TEST_ASSERT_EQUAL_HEX32(1, dest[3]);
+}
+
+void test_decode_dfa_kosme(void)
+{
+    utf_rune rbuf[6] = {0};
+    char *kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
+    utf_state_p state = utf_state_new();
+    int n = 0;
+    int i;
+
+    for (i = 0; i < 6; i++, kosme += n) {
+        n = utf_decode_dfa_r(&rbuf[i], kosme, UTF_BYTES_MAX, state);
+        TEST_ASSERT_FALSE_MESSAGE(utf_state_has_error(state), "Decode unexpectedly failed");
+    }
+
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x03BA, rbuf[0], "U+03BA GREEK SMALL LETTER KAPPA");
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x1F79, rbuf[1], "U+1F79 GREEK SMALL LETTER OMICRON WITH OXIA");
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x03C3, rbuf[2], "U+03C3 GREEK SMALL LETTER SIGMA");
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x03BC, rbuf[3], "U+03BC GREEK SMALL LETTER MU");
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x03B5, rbuf[4], "U+03B5 GREEK SMALL LETTER EPSILON");
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(0x0000, rbuf[5], "U+0000 NULL");
+
+    utf_state_destroy(state);
+}
+
+#define NUM_TESTS 14
+void test_decode_dfa_errors(void)
+{
+    const char* unknowns[NUM_TESTS] = {
+        "\x80",                /* lonely continuation */
+        "\xc0\xaf",            /* overlong 2 bytes */
+        "\xe0\x80\xaf",        /* overlong 3 bytes */
+        "\xf0\x80\x80\xaf",    /* overlong 4 bytes */
+        "\xed\xa0\x80",        /* U+D800 */
+        "\xf4\x90\x80\x80",    /* U+110000 */
+        "\xf8\x88\x80\x80",    /* 5 byte lead */
+        "\xfe",                /* BOM byte */
+        "\xe1\x80\x41",        /* missing continuation */
+        "\xe1\x80",            /* truncated */
+        "\xef\xbf\xbe",        /* U+FFFE */
+        "\xef\xb7\x90",        /* U+FDD0 */
+        "\xf4\x8f\xbf\xbd",    /* U+10FFFD */
+        "\xef\xbb\xbf"         /* U+FEFF */
+    };
+
+    int unknowns_sz[NUM_TESTS] = { 1, 2, 3, 4, 3, 4, 4, 1, 3, 2, 3, 3, 4, 3 };
+    int errors[NUM_TESTS] = {
+        UTF_ESTART, UTF_ELEN, UTF_ELEN, UTF_ELEN, UTF_ESEQ, UTF_ELIMIT,
+        UTF_ELIMIT, UTF_EVALUE, UTF_ESEQ, UTF_ETRUNC, UTF_ESEQ, UTF_ESEQ,
+        UTF_SUCCESS, UTF_SUCCESS
+    };
+    int lengths[NUM_TESTS] = { 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 3, 4, 3 };
+
+    utf_state_p state = utf_state_new();
+    utf_rune rune;
+    int i, n;
+
+    for (i = 0; i < NUM_TESTS; i++) {
+        utf_state_clear(state);
+        rune = 0;
+        n = utf_decode_dfa_r(&rune, (char*)unknowns[i], unknowns_sz[i], state);
+
+        TEST_ASSERT_EQUAL_MESSAGE(errors[i], utf_state_get_error(state), "Has an incorrect error code");
+        TEST_ASSERT_EQUAL_MESSAGE(lengths[i], n, "Has an incorrect sequence length");
+
+        if (errors[i] != UTF_SUCCESS) {
+            TEST_ASSERT_EQUAL_HEX32(0, rune);
+        }
+    }
+
+    utf_state_destroy(state);
+}
+#undef NUM_TESTS
+
+void test_decode_dfa_resume(void)
+{
+    char *seq = "\xf0\x9f\x98\x80\xe2\x82\x41";
+    utf_state_p state = utf_state_new();
+    utf_rune rune = 0;
+    int n;
+
+    /* U+1F600 split over three calls. */
+    n = utf_decode_dfa_r(&rune, seq, 1, state);
+    TEST_ASSERT_EQUAL(1, n);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_state_get_error(state));
+
+    n = utf_decode_dfa_r(&rune, seq + 1, 2, state);
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_state_get_error(state));
+
+    n = utf_decode_dfa_r(&rune, seq + 3, 4, state);
+    TEST_ASSERT_EQUAL(1, n);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_state_get_error(state));
+    TEST_ASSERT_EQUAL_HEX32(0x1F600, rune);
+
+    /* A kept partial rune that turns out to be invalid consumes nothing. */
+    n = utf_decode_dfa_r(&rune, seq + 4, 2, state);
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_state_get_error(state));
+
+    n = utf_decode_dfa_r(&rune, seq + 6, 1, state);
+    TEST_ASSERT_EQUAL(0, n);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_state_get_error(state));
+
+    n = utf_decode_dfa_r(&rune, seq + 6, 1, state);
+    TEST_ASSERT_EQUAL(1, n);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_state_get_error(state));
+    TEST_ASSERT_EQUAL_HEX32(0x41, rune);
+
+    utf_state_destroy(state);
+}
+
+void test_decode_by_value(void)
+{
+    utf_decoded_s decoded;
+
+    decoded = utf_decoderune_v("\xE1\xBD\xB9\xCF\x83", 5);
+    TEST_ASSERT_EQUAL_HEX32(0x1F79, decoded.rune);
+    TEST_ASSERT_EQUAL(3, decoded.len);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, decoded.error);
+
+    decoded = utf_decoderune_v("\xE0\x80\xAF", 3);
+    TEST_ASSERT_EQUAL_HEX32(0, decoded.rune);
+    TEST_ASSERT_EQUAL(1, decoded.len);
+    TEST_ASSERT_EQUAL(UTF_ELEN, decoded.error);
+}
+
+void test_decode_inline(void)
+{
+    const char* inputs[] = {
+        "a", "\xCE\xBA", "\xE1\xBD\xB9", "\xF0\x9F\x98\x80", "\x80",
+        "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xEF\xBF\xBE",
+        "\xF4\x90\x80\x80", "\xF8", "\xFE", "\xE1\xBD", "\xE1\x41"
+    };
+    utf_decoded_s expected, decoded;
+    char encoded[4];
+    size_t i;
+    int len;
+
+    for (i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        len = (int)strlen(inputs[i]);
+        expected = utf_decoderune_v(inputs[i], len);
+        decoded = utf_inline_decoderune(inputs[i], len);
+        TEST_ASSERT_EQUAL_HEX32(expected.rune, decoded.rune);
+        TEST_ASSERT_EQUAL(expected.len, decoded.len);
+        TEST_ASSERT_EQUAL(expected.error, decoded.error);
+
+        if (decoded.error == UTF_SUCCESS) {
+            TEST_ASSERT_EQUAL(len, utf_inline_encoderune(encoded,
+                                                         decoded.rune));
+            TEST_ASSERT_EQUAL_MEMORY(inputs[i], encoded, len);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, utf_inline_encoderune(encoded, 0xD800));
+    TEST_ASSERT_EQUAL(0, utf_inline_encoderune(encoded, 0x110000));
+}
+
+void test_decode_utf16(void)
+{
+    const char* s = "\xCE\xBA\xE1\xBD\xB9\xF0\x9F\x98\x80" "abcdefghijklmnopqrstuvwxyz"
+                    "abcdefghijklmnopqrstuvwxyz\xCF\x83\xED\xA0\x80";
+    utf_char16 dest[64];
+    const char* p;
+    size_t n;
+
+    p = s;
+    n = utf_mbsnrtoutf16(dest, &p, strlen(s), 64, UTF_ENCODING_UTF16LE);
+    TEST_ASSERT_EQUAL(4 + 52 + 1, n);
+    TEST_ASSERT_EQUAL_PTR(s + strlen(s) - 3, p);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+    TEST_ASSERT_EQUAL_MEMORY("\xBA\x03\x79\x1F\x3D\xD8\x00\xDE" "a\0", dest, 10);
+
+    p = s;
+    n = utf_mbsnrtoutf16(dest, &p, 9, 64, UTF_ENCODING_UTF16BE);
+    TEST_ASSERT_EQUAL(4, n);
+    TEST_ASSERT_EQUAL_MEMORY("\x03\xBA\x1F\x79\xD8\x3D\xDE\x00", dest, 8);
+
+    /* Surrogate pairs are not split when dest is full. */
+    p = s;
+    n = utf_mbsnrtoutf16(dest, &p, strlen(s), 3, UTF_ENCODING_UTF16LE);
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL_PTR(s + 5, p);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    p = s;
+    TEST_ASSERT_EQUAL(57, utf_mbsnrtoutf16(0, &p, strlen(s), 0,
+                                           UTF_ENCODING_UTF16BE));
+
+    p = s;
+    TEST_ASSERT_EQUAL(0, utf_mbsnrtoutf16(dest, &p, 9, 64, UTF_ENCODING_UTF8));
+    TEST_ASSERT_EQUAL(UTF_EVALUE, utf_errno);
+}
+
+void test_decode_latin1(void)
+{
+    const char* s = "caf\xC3\xA9 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9 "
+                    "\xC2\xA9 2022, \xC2\xBFqu\xC3\xA9 tal? \xE2\x82\xAC" "5";
+    const char* expected = "caf\xE9 na\xEFve r\xE9sum\xE9 \xA9 2022, \xBFqu\xE9 tal? ";
+    char dest[64];
+    const char* p;
+    size_t n;
+
+    /* Stops at the euro sign, which Latin-1 does not have. */
+    p = s;
+    n = utf_utf8_to_latin1(dest, &p, strlen(s), sizeof(dest));
+    TEST_ASSERT_EQUAL(strlen(expected), n);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n);
+    TEST_ASSERT_EQUAL_PTR(strstr(s, "\xE2"), p);
+    TEST_ASSERT_EQUAL(UTF_ERANGE, utf_errno);
+
+    p = s;
+    n = utf_utf8_to_latin1(dest, &p, 5, sizeof(dest));
+    TEST_ASSERT_EQUAL(4, n);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    p = s;
+    n = utf_utf8_to_latin1(dest, &p, 4, sizeof(dest));
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+}
+
+void test_decode_cesu8(void)
+{
+    const char cesu8[] = "a\0\xED\xA0\xBD\xED\xB8\x80\xC3\xA9";
+    const char mutf8[] = "a\xC0\x80\xED\xA0\xBD\xED\xB8\x80\xC3\xA9";
+    const char expected[] = "a\0\xF0\x9F\x98\x80\xC3\xA9";
+    char dest[16];
+    const char* p;
+    size_t n;
+
+    p = cesu8;
+    n = utf_cesu8_to_utf8(dest, &p, sizeof(cesu8) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(sizeof(expected) - 1, n);
+    TEST_ASSERT_EQUAL_PTR(cesu8 + sizeof(cesu8) - 1, p);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    p = mutf8;
+    n = utf_mutf8_to_utf8(dest, &p, sizeof(mutf8) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(sizeof(expected) - 1, n);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n);
+
+    /* C0 80 is only allowed in Modified UTF-8. */
+    p = mutf8;
+    n = utf_cesu8_to_utf8(dest, &p, sizeof(mutf8) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(1, n);
+    TEST_ASSERT_EQUAL_PTR(mutf8 + 1, p);
+    TEST_ASSERT_EQUAL(UTF_ELEN, utf_errno);
+
+    /* A cut-off pair is truncated, and a lone surrogate is not allowed. */
+    p = cesu8;
+    n = utf_cesu8_to_utf8(dest, &p, 6, sizeof(dest));
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL_PTR(cesu8 + 2, p);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+
+    p = "\xED\xA0\xBD\xC3\xA9";
+    n = utf_cesu8_to_utf8(dest, &p, 5, sizeof(dest));
+    TEST_ASSERT_EQUAL(0, n);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+
+    /* So are four-byte sequences. */
+    p = expected;
+    n = utf_cesu8_to_utf8(dest, &p, sizeof(expected) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+
+    /* Pairs are not split when dest is full. */
+    p = cesu8;
+    n = utf_cesu8_to_utf8(dest, &p, sizeof(cesu8) - 1, 5);
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL_PTR(cesu8 + 2, p);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+}
+
+void test_decode_stream(void)
+{
+    const char* kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
+    utf_rune expected[5] = { 0x03BA, 0x1F79, 0x03C3, 0x03BC, 0x03B5 };
+    utf_rune dest[8];
+    utf_state_p state = utf_state_new();
+    size_t chunk, i, out, consumed, produced;
+    int error;
+
+    /* Every chunk size splits the runes at different points. */
+    for (chunk = 1; chunk <= 11; chunk++) {
+        memset(dest, 0, sizeof(dest));
+        utf_state_clear(state);
+        out = 0;
+
+        for (i = 0; i < 11; i += consumed) {
+            error = utf_decode_stream_r(state, kosme + i,
+                                        (11 - i < chunk) ? 11 - i : chunk,
+                                        dest + out, 8 - out,
+                                        &consumed, &produced);
+            TEST_ASSERT_EQUAL_MESSAGE(UTF_SUCCESS, error, "Decode unexpectedly failed");
+            out += produced;
+        }
+
+        TEST_ASSERT_EQUAL_MESSAGE(0, utf_state_bytes_processed(state), "Left a partial rune");
+        TEST_ASSERT_EQUAL_MESSAGE(5, out, "Has an incorrect number of runes");
+        TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, dest, 5);
+    }
+
+    /* A partial rune at the end of the stream is left in the state. */
+    utf_state_clear(state);
+    error = utf_decode_stream_r(state, kosme, 4, dest, 8, &consumed, &produced);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, error);
+    TEST_ASSERT_EQUAL(4, consumed);
+    TEST_ASSERT_EQUAL(1, produced);
+    TEST_ASSERT_EQUAL(2, utf_state_bytes_processed(state));
+
+    /* The partial rune is rejected by the next buffer. */
+    error = utf_decode_stream_r(state, "A", 1, dest, 8, &consumed, &produced);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, error);
+    TEST_ASSERT_EQUAL(0, consumed);
+    TEST_ASSERT_EQUAL(0, produced);
+
+    utf_state_destroy(state);
+}
+
+void test_decode_lossy(void)
+{
+    /* Examples of maximal subparts from the Unicode Standard, section 3.9. */
+    const char* seq1 = "\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64";
+    const char* seq2 = "\xC0\xAF\xE0\x80\xBF\xF0\x81\x82\x41";
+    utf_rune expected1[10] = {
+        0x61, 0xFFFD, 0xFFFD, 0xFFFD, 0x62, 0xFFFD, 0x63, 0xFFFD, 0xFFFD, 0x64
+    };
+    utf_rune expected2[9] = {
+        0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0x41
+    };
+    utf_rune dest[16];
+    const char* src;
+    size_t n;
+
+    src = seq1;
+    n = utf_mbsnrtoufs_lossy(dest, &src, 13, 16);
+    TEST_ASSERT_EQUAL_MESSAGE(10, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(13, src - seq1, "Has an incorrect number of bytes consumed");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_ESEQ, utf_errno, "Has an incorrect error code");
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected1, dest, 10);
+
+    src = seq2;
+    n = utf_mbsnrtoufs_lossy(dest, &src, 9, 16);
+    TEST_ASSERT_EQUAL_MESSAGE(9, n, "Has an incorrect number of runes");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_ELEN, utf_errno, "Has an incorrect error code");
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected2, dest, 9);
+
+    /* Counting only, and stopping when dest is full. */
+    src = seq1;
+    TEST_ASSERT_EQUAL(10, utf_mbsnrtoufs_lossy(0, &src, 13, 0));
+
+    src = seq1;
+    n = utf_mbsnrtoufs_lossy(dest, &src, 13, 3);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(6, src - seq1);
+}
+
+void test_decode_sanitize(void)
+{
+    const char* seq = "\x61\xF1\x80\x80\xE1\x80\xC2\x62\xCE\xBA";
+    const char* expected = "\x61\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\x62\xCE\xBA";
+    char dest[16] = {0};
+    const char* src;
+    size_t n;
+
+    src = seq;
+    n = utf_mbsnrsanitize(dest, &src, 10, sizeof(dest));
+    TEST_ASSERT_EQUAL_MESSAGE(13, n, "Has an incorrect number of bytes written");
+    TEST_ASSERT_EQUAL_MESSAGE(10, src - seq, "Has an incorrect number of bytes consumed");
+    TEST_ASSERT_EQUAL_STRING(expected, dest);
+
+    /* Runes are not split when dest fills up. */
+    memset(dest, 0, sizeof(dest));
+    src = seq;
+    n = utf_mbsnrsanitize(dest, &src, 10, 12);
+    TEST_ASSERT_EQUAL(11, n);
+    TEST_ASSERT_EQUAL(8, src - seq);
+
+    src = seq;
+    TEST_ASSERT_EQUAL(13, utf_mbsnrsanitize(0, &src, 10, 0));
+}
+
+void test_decode_view(void)
+{
+    const char* ascii = "plain ASCII text";
+    const char* seq = "\x61\xF1\x80\x80\xE1\x80\xC2\x62\xCE\xBA";
+    const char* expected = "\x61\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\x62\xCE\xBA";
+    utf_view_s view;
+
+    /* Input that needs no change is borrowed. */
+    TEST_ASSERT_EQUAL(0, utf_convert_view(ascii, strlen(ascii),
+                                          UTF_ENCODING_LATIN1,
+                                          UTF_ENCODING_UTF8, &view));
+    TEST_ASSERT_EQUAL_PTR(ascii, view.data);
+    TEST_ASSERT_NULL(view.owned);
+    TEST_ASSERT_EQUAL(strlen(ascii), view.len);
+    TEST_ASSERT_EQUAL(strlen(ascii), view.consumed);
+    utf_view_release(&view);
+
+    TEST_ASSERT_EQUAL(0, utf_convert_view(seq + 7, 3, UTF_ENCODING_UTF8,
+                                          UTF_ENCODING_UTF8, &view));
+    TEST_ASSERT_EQUAL_PTR(seq + 7, view.data);
+    TEST_ASSERT_NULL(view.owned);
+    utf_view_release(&view);
+
+    /* Otherwise a copy is made, from the first byte that needs it on. */
+    TEST_ASSERT_EQUAL(0, utf_convert_view(seq, 10, UTF_ENCODING_UTF8,
+                                          UTF_ENCODING_UTF8, &view));
+    TEST_ASSERT_NOT_NULL(view.owned);
+    TEST_ASSERT_EQUAL_PTR(view.owned, view.data);
+    TEST_ASSERT_EQUAL(13, view.len);
+    TEST_ASSERT_EQUAL(10, view.consumed);
+    TEST_ASSERT_EQUAL_MEMORY(expected, view.data, 13);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+    utf_view_release(&view);
+    TEST_ASSERT_NULL(view.owned);
+
+    TEST_ASSERT_EQUAL(0, utf_convert_view("a\0b", 3, UTF_ENCODING_UTF8,
+                                          UTF_ENCODING_MUTF8, &view));
+    TEST_ASSERT_EQUAL(4, view.len);
+    TEST_ASSERT_EQUAL_MEMORY("a\xC0\x80" "b", view.data, 4);
+    utf_view_release(&view);
+
+    /* A conversion that stops at once still borrows the prefix. */
+    TEST_ASSERT_EQUAL(0, utf_convert_view("ab\xE2\x82\xAC", 5,
+                                          UTF_ENCODING_UTF8,
+                                          UTF_ENCODING_LATIN1, &view));
+    TEST_ASSERT_NULL(view.owned);
+    TEST_ASSERT_EQUAL(2, view.len);
+    TEST_ASSERT_EQUAL(2, view.consumed);
+    TEST_ASSERT_EQUAL(UTF_ERANGE, utf_errno);
+
+    TEST_ASSERT_EQUAL(-1, utf_convert_view(ascii, 5, UTF_ENCODING_LATIN1,
+                                           UTF_ENCODING_CESU8, &view));
+}
+
+/* An arena that hands out blocks from a static buffer and counts them, and the
+ * calls made to it. */
+typedef struct {
+    char buf[256];
+    size_t used;
+    int live;
+    int allocs;
+    int frees;
+    size_t live_bytes;
+} test_arena_s;
+
+static void* test_arena_alloc(void* user, size_t size)
+{
+    test_arena_s* arena = (test_arena_s*)user;
+    size_t rounded = (size + 15) & ~(size_t)15;
+    void* p;
+
+    arena->allocs++;
+    if (arena->used + rounded > sizeof(arena->buf)) {
+        return 0;
+    }
+
+    p = arena->buf + arena->used;
+    arena->used += rounded;
+    arena->live++;
+    arena->live_bytes += size;
+    return p;
+}
+
+static void test_arena_free(void* user, void* p, size_t size)
+{
+    test_arena_s* arena = (test_arena_s*)user;
+
+    (void)p;
+    arena->frees++;
+    arena->live--;
+    arena->live_bytes -= size;
+}
+
+void test_decode_allocator(void)
+{
+    const utf_rune runes[] = { 0x03BA, 0x1F79, 0 };
+    test_arena_s arena = {{0}, 0, 0, 0, 0, 0};
+    utf_allocator_s allocator;
+    utf_state_p state;
+    utf_rune* copy;
+    utf_view_s view;
+
+    allocator.alloc = test_arena_alloc;
+    allocator.free = test_arena_free;
+    allocator.user = &arena;
+
+    /* Per call. */
+    state = utf_state_new_with(&allocator);
+    TEST_ASSERT_NOT_NULL(state);
+    TEST_ASSERT_EQUAL(1, arena.live);
+    utf_state_clear(state);
+    utf_state_destroy(state);
+    TEST_ASSERT_EQUAL(0, arena.live);
+
+    TEST_ASSERT_EQUAL(0, utf_convert_view_with("caf\xE9", 4,
+                                               UTF_ENCODING_LATIN1,
+                                               UTF_ENCODING_UTF8, &view,
+                                               &allocator));
+    TEST_ASSERT_EQUAL(1, arena.live);
+    TEST_ASSERT_EQUAL_MEMORY("caf\xC3\xA9", view.data, 5);
+    utf_view_release(&view);
+    TEST_ASSERT_EQUAL(0, arena.live);
+
+    /* Globally, until it is restored. */
+    utf_set_allocator(&allocator);
+    copy = utf_strdup(runes);
+    state = utf_state_new();
+    utf_set_allocator(0);
+
+    TEST_ASSERT_EQUAL(2, arena.live);
+    TEST_ASSERT_EQUAL_MEMORY(runes, copy, sizeof(runes));
+    TEST_ASSERT_TRUE((char*)copy >= arena.buf &&
+                     (char*)copy < arena.buf + sizeof(arena.buf));
+    utf_state_destroy(state);
+    TEST_ASSERT_EQUAL(1, arena.live);
+    TEST_ASSERT_EQUAL(sizeof(runes), arena.live_bytes);
+
+    /* Every block is allocated once, and freed with the size it was
+     * allocated with. */
+    TEST_ASSERT_EQUAL(4, arena.allocs);
+    TEST_ASSERT_EQUAL(3, arena.frees);
+
+    /* A failed allocation is reported rather than fatal. */
+    arena.used = sizeof(arena.buf);
+    TEST_ASSERT_NULL(utf_state_new_with(&allocator));
+    TEST_ASSERT_NULL(utf_strdup_with(runes, &allocator));
+    TEST_ASSERT_EQUAL(6, arena.allocs);
+    TEST_ASSERT_EQUAL(3, arena.frees);
+}
+
+void test_decode_mbsnrtoufs_mt(void)
+{
+    const char* kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
+    size_t len = (size_t)4 << 20;
+    char* src = malloc(len);
+    utf_rune* expected = malloc(len * sizeof(utf_rune));
+    utf_rune* dest = malloc(len * sizeof(utf_rune));
+    const char* p;
+    size_t i, n, m;
+
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(dest);
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        memcpy(&src[i], "text ", 5);
+        memcpy(&src[i + 5], kosme, 11);
+    }
+
+    p = src;
+    n = utf_mbsnrtoufs(expected, &p, len, len);
+
+    p = src;
+    m = utf_mbsnrtoufs_mt(dest, &p, len, len, 4);
+    TEST_ASSERT_EQUAL(n, m);
+    TEST_ASSERT_EQUAL(len, p - src);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n * sizeof(utf_rune));
+
+    /* Stops when dest is full in the middle of the second chunk. */
+    p = src;
+    utf_mbsnrtoufs(expected, &p, len, n / 3);
+    i = (size_t)(p - src);
+    p = src;
+    m = utf_mbsnrtoufs_mt(dest, &p, len, n / 3, 4);
+    TEST_ASSERT_EQUAL(n / 3, m);
+    TEST_ASSERT_EQUAL(i, p - src);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, m * sizeof(utf_rune));
+
+    /* Stops at a malformed sequence in the third chunk. */
+    src[len / 2 + 3] = '\xFF';
+    p = src;
+    n = utf_mbsnrtoufs(expected, &p, len, len);
+    p = src;
+    m = utf_mbsnrtoufs_mt(dest, &p, len, len, 4);
+    TEST_ASSERT_EQUAL(n, m);
+    TEST_ASSERT_EQUAL(len / 2 + 3, p - src);
+    TEST_ASSERT_EQUAL(UTF_EVALUE, utf_errno);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n * sizeof(utf_rune));
+
+    free(dest);
+    free(expected);
+    free(src);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -899,6 +1582,24 @@ int main(void)
         RUN_TEST(test_decode_illegal_single_surrogate);
         RUN_TEST(test_decode_illegal_paired_surrogates);
         RUN_TEST(test_decode_problematic_nonchar);
+        RUN_TEST(test_decode_mbsnrtoufs_kosme);
+        RUN_TEST(test_decode_mbsnrtoufs_long);
+        RUN_TEST(test_decode_mbsnrtoufs_stops);
+        RUN_TEST(test_decode_mbsrtoufs);
+        RUN_TEST(test_decode_dfa_kosme);
+        RUN_TEST(test_decode_dfa_errors);
+        RUN_TEST(test_decode_dfa_resume);
+        RUN_TEST(test_decode_by_value);
+        RUN_TEST(test_decode_inline);
+        RUN_TEST(test_decode_utf16);
+        RUN_TEST(test_decode_latin1);
+        RUN_TEST(test_decode_cesu8);
+        RUN_TEST(test_decode_stream);
+        RUN_TEST(test_decode_lossy);
+        RUN_TEST(test_decode_sanitize);
+        RUN_TEST(test_decode_view);
+        RUN_TEST(test_decode_allocator);
+        RUN_TEST(test_decode_mbsnrtoufs_mt);
     }
     return UNITY_END();
 }
@@ -29,6 +29,8 @@ SPDX-License-Identifier: MIT
 
 #include "unity.h"
 
+#include <string.h>
+
 void setUp(void) {}
 
 void tearDown(void) {}
@@ -38,7 +40,7 @@ void tearDown(void) {}
 
 void test_encode_kosme(void)
 {
-    char dest[6] = {0};
+    char dest[12] = {0};
     utf_rune src[6] = {0x03BA, 0x1F79, 0x03C3, 0x03BC, 0x03B5, 0x0000};
     char *kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
     int n = 0;
@@ -55,11 +57,223 @@ void test_encode_kosme(void)
     TEST_ASSERT_EQUAL_STRING_MESSAGE(kosme, dest, "String incorrectly encoded");
 }
 
+void test_encode_by_value(void)
+{
+    utf_encoded_s encoded;
+
+    encoded = utf_encoderune_v(0x1F79);
+    TEST_ASSERT_EQUAL_MESSAGE(3, encoded.len, "Incorrect number of bytes encoded");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_SUCCESS, encoded.error, "Encode unexpectedly failed");
+    TEST_ASSERT_EQUAL_HEX8(0xE1, (unsigned char)encoded.bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBD, (unsigned char)encoded.bytes[1]);
+    TEST_ASSERT_EQUAL_HEX8(0xB9, (unsigned char)encoded.bytes[2]);
+
+    encoded = utf_encoderune_v(0x110000);
+    TEST_ASSERT_EQUAL_MESSAGE(0, encoded.len, "Encoded a rune out of range");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_ESEQ, encoded.error, "Has an incorrect error code");
+}
+
+void test_encode_utfsnrtombs(void)
+{
+    char dest[300] = {0};
+    utf_rune src[128];
+    const utf_rune* p;
+    size_t i, n;
+
+    /* Long enough for the vector paths, with every length of rune. */
+    for (i = 0; i < 128; i++) {
+        switch (i % 4) {
+            case 0: src[i] = 'a' + (utf_rune)(i % 26); break;
+            case 1: src[i] = 0x03BA; break;
+            case 2: src[i] = 0x1F79; break;
+            case 3: src[i] = (i % 32 == 31) ? 0x1F600 : 0x20AC; break;
+        }
+    }
+
+    p = src;
+    n = utf_utfsnrtombs(dest, &p, 128, sizeof(dest));
+    TEST_ASSERT_EQUAL_MESSAGE(128 / 4 * 9 + 4, n, "Incorrect number of bytes encoded");
+    TEST_ASSERT_EQUAL_MESSAGE(128, p - src, "Incorrect number of runes consumed");
+    TEST_ASSERT_EQUAL_MESSAGE(UTF_SUCCESS, utf_errno, "Encode unexpectedly failed");
+    TEST_ASSERT_EQUAL_MEMORY("a\xCE\xBA\xE1\xBD\xB9\xE2\x82\xAC", dest, 9);
+    TEST_ASSERT_EQUAL_MEMORY("\xF0\x9F\x98\x80", &dest[7 * 9 + 6], 4);
+
+    /* Runes are not split when dest is full. */
+    p = src;
+    n = utf_utfsnrtombs(dest, &p, 128, 5);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(2, p - src);
+
+    /* Stops in front of a surrogate. */
+    src[70] = 0xD800;
+    p = src;
+    n = utf_utfsnrtombs(0, &p, 128, 0);
+    TEST_ASSERT_EQUAL(70, p - src);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+}
+
+void test_encode_utfsrtombs(void)
+{
+    char dest[8];
+    utf_rune src[3] = { 0x03BA, 'a', 0 };
+    const utf_rune* p = src;
+    size_t n;
+
+    memset(dest, 1, sizeof(dest));
+    n = utf_utfsrtombs(dest, &p, sizeof(dest));
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(2, p - src);
+    TEST_ASSERT_EQUAL_STRING("\xCE\xBA" "a", dest);
+}
+
+void test_encode_lengths(void)
+{
+    utf_rune src[40];
+    const utf_rune* p;
+    size_t i;
+
+    for (i = 0; i < 40; i++) {
+        src[i] = (i % 5 == 4) ? 0x1F600 : (utf_rune)(0x3B8 * (i % 5));
+    }
+
+    p = src;
+    TEST_ASSERT_EQUAL(utf_utfsnrtombs(0, &p, 40, 0), utf_utf8len(src, 40));
+    TEST_ASSERT_EQUAL(8 * (1 + 2 + 2 + 3 + 4), utf_utf8len(src, 40));
+    TEST_ASSERT_EQUAL(48, utf_utf16len_runes(src, 40));
+
+    /* Stops in front of an unencodable rune, as encoding does. */
+    src[33] = 0x110000;
+    TEST_ASSERT_EQUAL(6 * 12 + 1 + 2 + 2, utf_utf8len(src, 40));
+    TEST_ASSERT_EQUAL(UTF_ELIMIT, utf_errno);
+
+    TEST_ASSERT_EQUAL(2, utf_encoderune(0, &src[1]));
+}
+
+void test_encode_utf16(void)
+{
+    utf_char16 src[40];
+    const utf_char16* p;
+    char dest[128];
+    size_t i, n;
+
+    for (i = 0; i < 40; i++) {
+        src[i] = (utf_char16)('a' + i % 26);
+    }
+    src[0] = 0x03BA;
+    src[1] = 0x1F79;
+    src[2] = 0xD83D;
+    src[3] = 0xDE00;
+    src[20] = 0x20AC;
+
+    p = src;
+    n = utf_utf16snrtombs(dest, &p, 40, sizeof(dest), UTF_ENCODING_UTF16LE);
+    TEST_ASSERT_EQUAL(2 + 3 + 4 + 35 + 3, n);
+    TEST_ASSERT_EQUAL(40, p - src);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+    TEST_ASSERT_EQUAL_MEMORY("\xCE\xBA\xE1\xBD\xB9\xF0\x9F\x98\x80" "ef", dest, 11);
+    TEST_ASSERT_EQUAL_MEMORY("\xE2\x82\xAC" "v", &dest[25], 4);
+
+    /* A high surrogate at the end is left for the next call. */
+    p = src;
+    n = utf_utf16snrtombs(dest, &p, 3, sizeof(dest), UTF_ENCODING_UTF16LE);
+    TEST_ASSERT_EQUAL(5, n);
+    TEST_ASSERT_EQUAL(2, p - src);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+
+    /* An unpaired low surrogate. */
+    src[30] = 0xDC00;
+    p = src;
+    TEST_ASSERT_EQUAL(2 + 3 + 4 + 25 + 3, utf_utf16snrtombs(0, &p, 40, 0,
+                      UTF_ENCODING_UTF16LE));
+    TEST_ASSERT_EQUAL(30, p - src);
+    TEST_ASSERT_EQUAL(UTF_ESEQ, utf_errno);
+
+    /* Code units in the other byte order. */
+    src[0] = 0xBA03;
+    p = src;
+    TEST_ASSERT_EQUAL(2, utf_utf16snrtombs(dest, &p, 1, sizeof(dest),
+                      UTF_BIG_ENDIAN ? UTF_ENCODING_UTF16LE
+                                     : UTF_ENCODING_UTF16BE));
+    TEST_ASSERT_EQUAL_MEMORY("\xCE\xBA", dest, 2);
+}
+
+void test_encode_latin1(void)
+{
+    const char* s = "caf\xE9 na\xEFve r\xE9sum\xE9 \xA9 2022, \xBFqu\xE9 tal?";
+    const char* expected = "caf\xC3\xA9 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9 "
+                           "\xC2\xA9 2022, \xC2\xBFqu\xC3\xA9 tal?";
+    char dest[64];
+    const char* p;
+    size_t n;
+
+    p = s;
+    n = utf_latin1_to_utf8(dest, &p, strlen(s), sizeof(dest));
+    TEST_ASSERT_EQUAL(strlen(expected), n);
+    TEST_ASSERT_EQUAL_PTR(s + strlen(s), p);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dest, n);
+
+    /* Two-byte runes are not split when dest is full. */
+    p = s;
+    n = utf_latin1_to_utf8(dest, &p, strlen(s), 4);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL_PTR(s + 3, p);
+
+    p = s;
+    TEST_ASSERT_EQUAL(strlen(expected),
+                      utf_latin1_to_utf8(0, &p, strlen(s), 0));
+}
+
+void test_encode_cesu8(void)
+{
+    const char s[] = "a\0\xF0\x9F\x98\x80\xC3\xA9";
+    const char cesu8[] = "a\0\xED\xA0\xBD\xED\xB8\x80\xC3\xA9";
+    const char mutf8[] = "a\xC0\x80\xED\xA0\xBD\xED\xB8\x80\xC3\xA9";
+    char dest[16];
+    const char* p;
+    size_t n;
+
+    p = s;
+    n = utf_utf8_to_cesu8(dest, &p, sizeof(s) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(sizeof(cesu8) - 1, n);
+    TEST_ASSERT_EQUAL_PTR(s + sizeof(s) - 1, p);
+    TEST_ASSERT_EQUAL_MEMORY(cesu8, dest, n);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    p = s;
+    n = utf_utf8_to_mutf8(dest, &p, sizeof(s) - 1, sizeof(dest));
+    TEST_ASSERT_EQUAL(sizeof(mutf8) - 1, n);
+    TEST_ASSERT_EQUAL_MEMORY(mutf8, dest, n);
+
+    /* Surrogate pairs are not split when dest is full. */
+    p = s;
+    n = utf_utf8_to_mutf8(dest, &p, sizeof(s) - 1, 8);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL_PTR(s + 2, p);
+
+    p = s;
+    TEST_ASSERT_EQUAL(sizeof(mutf8) - 1,
+                      utf_utf8_to_mutf8(0, &p, sizeof(s) - 1, 0));
+
+    /* Malformed UTF-8 stops the conversion. */
+    p = s;
+    n = utf_utf8_to_cesu8(dest, &p, 4, sizeof(dest));
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL_PTR(s + 2, p);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
     if (TEST_PROTECT()) {
         RUN_TEST(test_encode_kosme);
+        RUN_TEST(test_encode_by_value);
+        RUN_TEST(test_encode_utfsnrtombs);
+        RUN_TEST(test_encode_utfsrtombs);
+        RUN_TEST(test_encode_lengths);
+        RUN_TEST(test_encode_utf16);
+        RUN_TEST(test_encode_latin1);
+        RUN_TEST(test_encode_cesu8);
     }
     return UNITY_END();
 }
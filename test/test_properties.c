@@ -26,9 +26,12 @@ SPDX-License-Identifier: MIT
 */
 
 #include <utf/utf.h>
+#include <utf/inline.h>
 
 #include "unity.h"
 
+#include <string.h>
+
 void setUp(void) {}
 
 void tearDown(void) {}
@@ -1942,6 +1945,215 @@ void test_isxdigit(void)
     TEST_ASSERT_FALSE(utf_isxdigit(2363)); /*     */
 }
 
+void test_out_of_range(void)
+{
+    /* Block and leaf boundaries of the lookup tables. */
+    TEST_ASSERT_TRUE(utf_isalpha(0x7FA));
+    TEST_ASSERT_FALSE(utf_isalpha(0x7FF));
+    TEST_ASSERT_TRUE(utf_isalpha(0x800));
+    TEST_ASSERT_TRUE(utf_isalpha(0x3134A));
+    TEST_ASSERT_FALSE(utf_isalpha(0x3134B));
+
+    /* Either side of the end of the Latin-1 table. */
+    TEST_ASSERT_TRUE(utf_islower(0xFF));
+    TEST_ASSERT_FALSE(utf_isupper(0xFF));
+    TEST_ASSERT_TRUE(utf_isupper(0x100));
+    TEST_ASSERT_FALSE(utf_islower(0x100));
+
+    TEST_ASSERT_FALSE(utf_isprint(0x110000));
+    TEST_ASSERT_FALSE(utf_isalpha(0x110041));
+    TEST_ASSERT_FALSE(utf_iscntrl(0xFFFFFFFF));
+}
+
+void test_properties(void)
+{
+    utf_rune r;
+
+    TEST_ASSERT_EQUAL_HEX32(
+        UTF_CLASS_ALPHA | UTF_CLASS_ALNUM | UTF_CLASS_PRINT | UTF_CLASS_GRAPH |
+        UTF_CLASS_UPPER | UTF_CLASS_XDIGIT, utf_properties('A'));
+    TEST_ASSERT_EQUAL_HEX32(
+        UTF_CLASS_DIGIT | UTF_CLASS_ALNUM | UTF_CLASS_NUMBER |
+        UTF_CLASS_INTEGER | UTF_CLASS_PRINT | UTF_CLASS_GRAPH |
+        UTF_CLASS_XDIGIT, utf_properties('7'));
+    TEST_ASSERT_EQUAL_HEX32(
+        UTF_CLASS_PRINT | UTF_CLASS_BLANK | UTF_CLASS_SPACE,
+        utf_properties(' '));
+    TEST_ASSERT_EQUAL_HEX32(0, utf_properties(0x0301));
+    TEST_ASSERT_EQUAL_HEX32(0, utf_properties(0x0378));
+    TEST_ASSERT_EQUAL_HEX32(0, utf_properties(0x110000));
+
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_LU, utf_category('A'));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_LL, utf_category(0x00E9));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_LT, utf_category(0x01C5));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_MN, utf_category(0x0301));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_ND, utf_category('7'));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_PS, utf_category('('));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_SC, utf_category(0x20AC));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_ZS, utf_category(' '));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_CC, utf_category('\n'));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_CS, utf_category(0xD800));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_CO, utf_category(0xE000));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_CN, utf_category(0x0378));
+    TEST_ASSERT_EQUAL_INT(UTF_CATEGORY_CN, utf_category(0x110000));
+
+    /* The mask agrees with the predicates. */
+    for (r = 0; r < 0x3000; r++) {
+        uint_least32_t properties = utf_properties(r);
+
+        TEST_ASSERT_EQUAL(utf_isalpha(r), (properties & UTF_CLASS_ALPHA) != 0);
+        TEST_ASSERT_EQUAL(utf_isgraph(r), (properties & UTF_CLASS_GRAPH) != 0);
+        TEST_ASSERT_EQUAL(utf_ispunct(r), (properties & UTF_CLASS_PUNCT) != 0);
+        TEST_ASSERT_EQUAL(utf_isxdigit(r), (properties & UTF_CLASS_XDIGIT) != 0);
+    }
+}
+
+void test_classify(void)
+{
+    static const char text[] =
+        "Kosme \xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5 \xE2\x82\xAC" "5 "
+        "\xF0\x9D\x90\x80 and a long ASCII tail to fill a vector or two!!\x80";
+    uint_least32_t flags[80];
+    utf_rune runes[80];
+    const char* p;
+    size_t n, count, i;
+
+    p = text;
+    n = utf_mbsnrtoufs(runes, &p, sizeof(text) - 2, 80);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    utf_classify_n(runes, n, flags);
+    for (i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_HEX32(utf_properties(runes[i]), flags[i]);
+    }
+
+    memset(flags, 0, sizeof(flags));
+    p = text;
+    count = utf_mbsnrclassify(flags, &p, sizeof(text) - 1, 80);
+    TEST_ASSERT_EQUAL(UTF_ESTART, utf_errno);
+    TEST_ASSERT_EQUAL(n, count);
+    TEST_ASSERT_EQUAL_PTR(text + sizeof(text) - 2, p);
+    for (i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_HEX32(utf_properties(runes[i]), flags[i]);
+    }
+
+    /* Counting only, and stopping when dest is full. */
+    p = text;
+    TEST_ASSERT_EQUAL(n, utf_mbsnrclassify(0, &p, sizeof(text) - 2, 0));
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+
+    memset(flags, 0, sizeof(flags));
+    p = text;
+    TEST_ASSERT_EQUAL(8, utf_mbsnrclassify(flags, &p, sizeof(text) - 2, 8));
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+    TEST_ASSERT_EQUAL_PTR(text + 11, p);
+    TEST_ASSERT_EQUAL_HEX32(utf_properties(0x1F79), flags[7]);
+    TEST_ASSERT_EQUAL_HEX32(0, flags[8]);
+}
+
+void test_find_class(void)
+{
+    static const char text[] =
+        "   \t  identifier_with_a_long_name_1 = \xCE\xBA\xE1\xBD\xB9\xCF\x83"
+        "\xCE\xBC\xCE\xB5\xE3\x80\x80(more text after the ideographic space)";
+    size_t offset;
+
+    TEST_ASSERT_EQUAL(6, utf_span_class(text, sizeof(text) - 1,
+                                        UTF_CLASS_SPACE));
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+    TEST_ASSERT_EQUAL(0, utf_span_class(text, sizeof(text) - 1,
+                                        UTF_CLASS_ALNUM));
+    TEST_ASSERT_EQUAL(29, utf_span_class(text + 6, sizeof(text) - 7,
+                                         UTF_CLASS_ALNUM | UTF_CLASS_PUNCT));
+    TEST_ASSERT_EQUAL(sizeof(text) - 1, utf_span_class(text, sizeof(text) - 1,
+        UTF_CLASS_PRINT | UTF_CLASS_SPACE));
+
+    TEST_ASSERT_TRUE(utf_find_class(text, sizeof(text) - 1, UTF_CLASS_MATH,
+                                    &offset));
+    TEST_ASSERT_EQUAL(36, offset);
+    TEST_ASSERT_TRUE(utf_find_class(text + 36, sizeof(text) - 37,
+                                    UTF_CLASS_ALPHA, &offset));
+    TEST_ASSERT_EQUAL(2, offset);
+    TEST_ASSERT_TRUE(utf_find_class(text + 38, sizeof(text) - 39,
+                                    UTF_CLASS_SPACE, &offset));
+    TEST_ASSERT_EQUAL(11, offset);
+    TEST_ASSERT_TRUE(utf_find_class(text, sizeof(text) - 1, UTF_CLASS_PUNCT,
+                                    &offset));
+    TEST_ASSERT_EQUAL(16, offset);
+    TEST_ASSERT_FALSE(utf_find_class(text, sizeof(text) - 1, UTF_CLASS_TITLE,
+                                     &offset));
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_errno);
+    TEST_ASSERT_EQUAL(sizeof(text) - 1, offset);
+
+    /* A truncated rune stops the scan. */
+    TEST_ASSERT_FALSE(utf_find_class(text + 38, 3, UTF_CLASS_SPACE, &offset));
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+    TEST_ASSERT_EQUAL(2, offset);
+    TEST_ASSERT_EQUAL(2, utf_span_class(text + 38, 3, UTF_CLASS_ALPHA));
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_errno);
+}
+
+void test_case_mapping(void)
+{
+    TEST_ASSERT_EQUAL_HEX32('a', utf_tolower('A'));
+    TEST_ASSERT_EQUAL_HEX32('A', utf_toupper('a'));
+    TEST_ASSERT_EQUAL_HEX32('A', utf_totitle('a'));
+    TEST_ASSERT_EQUAL_HEX32('a', utf_tolower('a'));
+    TEST_ASSERT_EQUAL_HEX32('1', utf_toupper('1'));
+    TEST_ASSERT_EQUAL_HEX32(0x00FF, utf_tolower(0x0178));
+    TEST_ASSERT_EQUAL_HEX32(0x0178, utf_toupper(0x00FF));
+    TEST_ASSERT_EQUAL_HEX32(0x00DF, utf_toupper(0x00DF));
+    TEST_ASSERT_EQUAL_HEX32(0x03C3, utf_tolower(0x03A3));
+    TEST_ASSERT_EQUAL_HEX32(0x03A3, utf_toupper(0x03C2));
+    TEST_ASSERT_EQUAL_HEX32(0x0430, utf_tolower(0x0410));
+
+    /* Digraphs have a separate title case. */
+    TEST_ASSERT_EQUAL_HEX32(0x01C4, utf_toupper(0x01C6));
+    TEST_ASSERT_EQUAL_HEX32(0x01C5, utf_totitle(0x01C6));
+    TEST_ASSERT_EQUAL_HEX32(0x01C6, utf_tolower(0x01C5));
+    TEST_ASSERT_EQUAL_HEX32(0x01C5, utf_totitle(0x01C4));
+
+    /* Marks, numbers and symbols can have mappings too. */
+    TEST_ASSERT_EQUAL_HEX32(0x0399, utf_toupper(0x0345));
+    TEST_ASSERT_EQUAL_HEX32(0x0399, utf_totitle(0x0345));
+    TEST_ASSERT_EQUAL_HEX32(0x0345, utf_tolower(0x0345));
+    TEST_ASSERT_EQUAL_HEX32(0x2170, utf_tolower(0x2160));
+    TEST_ASSERT_EQUAL_HEX32(0x216F, utf_toupper(0x217F));
+    TEST_ASSERT_EQUAL_HEX32(0x24B6, utf_toupper(0x24D0));
+    TEST_ASSERT_EQUAL_HEX32(0x24E9, utf_tolower(0x24CF));
+    TEST_ASSERT_EQUAL_HEX32(0x24CF, utf_totitle(0x24E9));
+
+    /* Mappings far away, and far up. */
+    TEST_ASSERT_EQUAL_HEX32(0x026A, utf_tolower(0xA7AE));
+    TEST_ASSERT_EQUAL_HEX32(0xA7AE, utf_toupper(0x026A));
+    TEST_ASSERT_EQUAL_HEX32(0x2C65, utf_tolower(0x023A));
+    TEST_ASSERT_EQUAL_HEX32(0x1E943, utf_tolower(0x1E921));
+    TEST_ASSERT_EQUAL_HEX32(0x1E921, utf_totitle(0x1E943));
+
+    TEST_ASSERT_EQUAL_HEX32(0x110041, utf_tolower(0x110041));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, utf_toupper(0xFFFFFFFF));
+}
+
+void test_inline_primitives(void)
+{
+    utf_rune r;
+
+    for (r = 0; r <= 0x110000; r++) {
+        TEST_ASSERT_EQUAL(utf_is_pair_start(r), utf_inline_is_pair_start(r));
+        TEST_ASSERT_EQUAL(utf_is_pair_end(r), utf_inline_is_pair_end(r));
+        TEST_ASSERT_EQUAL(utf_is_pair(r), utf_inline_is_pair(r));
+        TEST_ASSERT_EQUAL(utf_is_valid_rune(r), utf_inline_is_valid_rune(r));
+        TEST_ASSERT_EQUAL(utf_runelen(r), utf_inline_runelen(r));
+    }
+
+    TEST_ASSERT_EQUAL(utf_runelen(0x200000), utf_inline_runelen(0x200000));
+    TEST_ASSERT_EQUAL(utf_runelen(0x4000000), utf_inline_runelen(0x4000000));
+    TEST_ASSERT_EQUAL(utf_runelen(0x80000000), utf_inline_runelen(0x80000000));
+    TEST_ASSERT_TRUE(utf_inline_is_rune_start('a'));
+    TEST_ASSERT_TRUE(utf_inline_is_rune_start('\xF0'));
+    TEST_ASSERT_FALSE(utf_inline_is_rune_start('\x80'));
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -1964,6 +2176,12 @@ int main(void)
         RUN_TEST(test_iscurrency);
         RUN_TEST(test_ismath);
         RUN_TEST(test_isxdigit);
+        RUN_TEST(test_out_of_range);
+        RUN_TEST(test_properties);
+        RUN_TEST(test_classify);
+        RUN_TEST(test_find_class);
+        RUN_TEST(test_case_mapping);
+        RUN_TEST(test_inline_primitives);
     }
     return UNITY_END();
 }
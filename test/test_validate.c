@@ -0,0 +1,483 @@
+/*
+MIT License
+
+Copyright (c) 2022 Ryan Egesdahl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+SPDX-FileCopyrightText: 2020 Ryan Egesdahl
+SPDX-License-Identifier: MIT
+*/
+
+#include <utf/utf.h>
+
+#include "unity.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BUF_SZ 256
+
+static const char* kosme = "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5";
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/* Fill buf with a mix of ASCII and kosme so that every vector block holds
+ * multi-byte runes, and return the number of bytes written. */
+static size_t fill_valid(char* buf, size_t sz)
+{
+    size_t n = 0;
+    size_t kosme_sz = strlen(kosme);
+
+    while (n + kosme_sz + 5 <= sz) {
+        memcpy(&buf[n], "text ", 5);
+        n += 5;
+        memcpy(&buf[n], kosme, kosme_sz);
+        n += kosme_sz;
+    }
+
+    return n;
+}
+
+/* Overwrite buf at every offset with seq and check that it is rejected. The
+ * offsets straddle every vector block boundary. */
+static void assert_rejected_everywhere(const char* seq)
+{
+    char buf[BUF_SZ];
+    size_t seq_sz = strlen(seq);
+    size_t len, i;
+
+    for (i = 0; i + seq_sz <= BUF_SZ; i++) {
+        memset(buf, 'a', BUF_SZ);
+        memcpy(&buf[i], seq, seq_sz);
+        TEST_ASSERT_FALSE(utf_validstring(buf, BUF_SZ));
+
+        len = fill_valid(buf, BUF_SZ);
+        if (i + seq_sz <= len) {
+            /* Only replace whole runes so the damage is the sequence itself. */
+            memset(buf, 'a', i + seq_sz);
+            memcpy(&buf[i], seq, seq_sz);
+            TEST_ASSERT_FALSE(utf_validstring(buf, len));
+        }
+    }
+}
+
+void test_validstring_empty(void)
+{
+    TEST_ASSERT_TRUE(utf_validstring("", 0));
+    TEST_ASSERT_FALSE(utf_validstring(0, 0));
+}
+
+void test_validstring_ascii(void)
+{
+    char buf[BUF_SZ];
+    size_t i;
+
+    for (i = 0; i < BUF_SZ; i++) {
+        buf[i] = (char)(i & 0x7F);
+    }
+
+    for (i = 0; i <= BUF_SZ; i++) {
+        TEST_ASSERT_TRUE(utf_validstring(buf, i));
+    }
+}
+
+void test_validstring_multibyte(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ);
+
+    TEST_ASSERT_TRUE(utf_validstring(kosme, strlen(kosme)));
+    TEST_ASSERT_TRUE(utf_validstring(buf, len));
+    TEST_ASSERT_TRUE(utf_validstring("\xc2\x80\xe0\xa0\x80\xf0\x90\x80\x80", 9));
+    TEST_ASSERT_TRUE(utf_validstring("\xdf\xbf\xed\x9f\xbf\xee\x80\x80", 8));
+    TEST_ASSERT_TRUE(utf_validstring("\xef\xbf\xbd\xf4\x8f\xbf\xbd", 7));
+}
+
+void test_validstring_truncated(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ);
+    size_t i;
+
+    TEST_ASSERT_FALSE(utf_validstring("\xc2", 1));
+    TEST_ASSERT_FALSE(utf_validstring("\xe0\xa0", 2));
+    TEST_ASSERT_FALSE(utf_validstring("\xf0\x90\x80", 3));
+
+    /* Cutting a valid string inside a rune must always be caught. */
+    for (i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_MESSAGE(
+                (buf[i] & 0xC0) != 0x80, utf_validstring(buf, i),
+                "Truncation not detected");
+    }
+}
+
+void test_validstring_unexpected_continuation(void)
+{
+    assert_rejected_everywhere("\x80");
+    assert_rejected_everywhere("\xbf");
+    assert_rejected_everywhere("\xc2\x80\x80");
+}
+
+void test_validstring_overlong(void)
+{
+    assert_rejected_everywhere("\xc0\xaf");
+    assert_rejected_everywhere("\xc1\xbf");
+    assert_rejected_everywhere("\xe0\x9f\xbf");
+    assert_rejected_everywhere("\xf0\x8f\xbf\xbf");
+}
+
+void test_validstring_surrogate(void)
+{
+    assert_rejected_everywhere("\xed\xa0\x80");
+    assert_rejected_everywhere("\xed\xbf\xbf");
+}
+
+void test_validstring_too_large(void)
+{
+    assert_rejected_everywhere("\xf4\x90\x80\x80");
+    assert_rejected_everywhere("\xf5\x80\x80\x80");
+    assert_rejected_everywhere("\xf8\x88\x80\x80\x80");
+    assert_rejected_everywhere("\xfe");
+    assert_rejected_everywhere("\xff");
+}
+
+void test_validstring_nonchar(void)
+{
+    assert_rejected_everywhere("\xef\xb7\x90");
+    assert_rejected_everywhere("\xef\xb7\xaf");
+    assert_rejected_everywhere("\xef\xbf\xbe");
+    assert_rejected_everywhere("\xef\xbf\xbf");
+    assert_rejected_everywhere("\xf0\x9f\xbf\xbe");
+    assert_rejected_everywhere("\xf4\x8f\xbf\xbf");
+}
+
+/* Fill buf with copies of the n bytes of pattern, and return the number of bytes
+ * written. */
+static size_t fill_pattern(char* buf, size_t sz, const char* pattern, size_t n)
+{
+    size_t len = 0;
+
+    while (len + n <= sz) {
+        memcpy(&buf[len], pattern, n);
+        len += n;
+    }
+
+    return len;
+}
+
+void test_validstring_bf_tail(void)
+{
+    /* U+4E3F ends in BF. Followed by another multi-byte rune, it only looks
+     * like the start of a non-character, FFFE or FFFF, to a check that tests
+     * for too many bytes. bench/bench_validate.c times such text. */
+    static const char cjk[] = "\xE4\xB8\xBF\xE4\xB8\x80\xE4\xB8\xBF";
+    char small[BUF_SZ];
+    size_t len, i;
+
+    for (i = 0; i < 64; i++) {
+        memset(small, 'a', BUF_SZ);
+        len = i + fill_pattern(small + i, BUF_SZ - i - 3, cjk,
+                               sizeof(cjk) - 1);
+        TEST_ASSERT_TRUE(utf_validstring(small, len));
+
+        /* A real non-character after them is still caught. */
+        memcpy(small + len, "\xEF\xBF\xBF", 3);
+        TEST_ASSERT_FALSE(utf_validstring(small, len + 3));
+    }
+}
+
+void test_runecount(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ);
+    size_t runes = len / 16 * 10;
+    size_t count = 0;
+
+    TEST_ASSERT_EQUAL(0, utf_runecount("", 0));
+    TEST_ASSERT_EQUAL(5, utf_runecount(kosme, 11));
+    TEST_ASSERT_EQUAL(runes, utf_runecount(buf, len));
+
+    TEST_ASSERT_TRUE(utf_runecount_valid(buf, len, &count));
+    TEST_ASSERT_EQUAL(runes, count);
+}
+
+void test_utf16len(void)
+{
+    const char* s = "\xF0\x9F\x98\x80 k\xCF\x8C\xE1\xBD\xB9\xF0\x9F\x98\x80"
+                    "\xF0\x9F\x98\x80 k\xCF\x8C\xE1\xBD\xB9\xF0\x9F\x98\x80"
+                    "\xF0\x9F\x98\x80 k\xCF\x8C\xE1\xBD\xB9\xF0\x9F\x98\x80";
+
+    TEST_ASSERT_EQUAL(0, utf_utf16len(s, 0));
+    TEST_ASSERT_EQUAL(2, utf_utf16len(s, 4));
+    TEST_ASSERT_EQUAL(3 * 8, utf_utf16len(s, strlen(s)));
+}
+
+void test_runecount_valid_stops(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ);
+    size_t count = 0;
+    size_t i;
+
+    /* An invalid byte at the start of each rune of kosme in turn. */
+    for (i = 5; i < len; i += 16) {
+        buf[i] = '\xFF';
+        TEST_ASSERT_FALSE(utf_runecount_valid(buf, len, &count));
+        TEST_ASSERT_EQUAL(utf_runecount(buf, i), count);
+        fill_valid(buf, BUF_SZ);
+    }
+
+    TEST_ASSERT_FALSE(utf_runecount_valid(0, 0, &count));
+    TEST_ASSERT_EQUAL(0, count);
+}
+
+void test_runenlen(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ - 1);
+
+    buf[len] = '\0';
+
+    TEST_ASSERT_EQUAL(0, utf_runenlen(kosme, 0));
+    TEST_ASSERT_EQUAL(2, utf_runenlen(kosme, 1));
+    TEST_ASSERT_EQUAL(5, utf_runenlen(kosme, 2));
+    TEST_ASSERT_EQUAL(11, utf_runenlen(kosme, 5));
+    TEST_ASSERT_EQUAL(11, utf_runenlen(kosme, 6));
+
+    /* Far enough in for the vector loop. */
+    TEST_ASSERT_EQUAL(16 * 10 + 5 + 2, utf_runenlen(buf, 10 * 10 + 6));
+    TEST_ASSERT_EQUAL(len, utf_runenlen(buf, len));
+}
+
+void test_runenlen_stops(void)
+{
+    char buf[BUF_SZ];
+    size_t page_sz = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = fill_valid(buf, BUF_SZ - 1);
+    size_t shift, n;
+    char* pages;
+    char* s;
+
+    pages = mmap(NULL, 2 * page_sz, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    TEST_ASSERT_TRUE(pages != MAP_FAILED);
+    TEST_ASSERT_EQUAL(0, mprotect(pages + page_sz, page_sz, PROT_NONE));
+
+    /* The string runs up to an unreadable page without a terminating NUL,
+     * so only the bytes of the runes asked for may be read. */
+    for (shift = 0; shift < 64; shift++) {
+        s = pages + page_sz - (len - shift);
+        memcpy(s, buf, len - shift);
+        buf[len - shift] = '\0';
+        n = utf_runecount(buf, len - shift) - 1;
+        TEST_ASSERT_EQUAL(utf_runenlen(buf, n), utf_runenlen(s, n));
+        fill_valid(buf, BUF_SZ - 1);
+    }
+
+    munmap(pages, 2 * page_sz);
+}
+
+void test_validate_ex(void)
+{
+    char buf[BUF_SZ];
+    size_t len = fill_valid(buf, BUF_SZ);
+    utf_validation_s result;
+    size_t i;
+
+    TEST_ASSERT_TRUE(utf_validate_ex(buf, len, &result));
+    TEST_ASSERT_EQUAL(len, result.offset);
+    TEST_ASSERT_EQUAL(len / 16 * 10, result.runes);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, result.error);
+
+    /* A surrogate in place of each rune of kosme in turn. */
+    for (i = 5; i + 3 <= len; i += 16) {
+        memcpy(&buf[i], "\xED\xA0\x80", 3);
+        TEST_ASSERT_FALSE(utf_validate_ex(buf, len, &result));
+        TEST_ASSERT_EQUAL(i, result.offset);
+        TEST_ASSERT_EQUAL(i / 16 * 10 + 5, result.runes);
+        TEST_ASSERT_EQUAL(UTF_ESEQ, result.error);
+        fill_valid(buf, BUF_SZ);
+    }
+
+    TEST_ASSERT_FALSE(utf_validate_ex(kosme, 10, &result));
+    TEST_ASSERT_EQUAL(9, result.offset);
+    TEST_ASSERT_EQUAL(4, result.runes);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, result.error);
+}
+
+void test_validate_mt(void)
+{
+    const char* seqs[4] = { "\xFF", "\xED\xA0\x80", "\x80\x80\x80\x80", "\xF0\x90" };
+    size_t len = (size_t)8 << 20;
+    char* buf = malloc(len);
+    utf_validation_s expected, result;
+    size_t at, i, j;
+
+    TEST_ASSERT_NOT_NULL(buf);
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        fill_valid(&buf[i], 16);
+    }
+
+    TEST_ASSERT_TRUE(utf_validate_mt(buf, len, &result, 4));
+    TEST_ASSERT_EQUAL(len, result.offset);
+    TEST_ASSERT_EQUAL(len / 16 * 10, result.runes);
+
+    /* Errors on either side of the boundary between the first two chunks. */
+    for (i = 0; i < 4; i++) {
+        for (at = ((size_t)2 << 20) - 6; at < ((size_t)2 << 20) + 6; at++) {
+            memcpy(&buf[at], seqs[i], strlen(seqs[i]));
+
+            utf_validate_ex(buf, len, &expected);
+            TEST_ASSERT_FALSE(utf_validate_mt(buf, len, &result, 4));
+            TEST_ASSERT_EQUAL(expected.offset, result.offset);
+            TEST_ASSERT_EQUAL(expected.runes, result.runes);
+            TEST_ASSERT_EQUAL(expected.error, result.error);
+
+            for (j = at - at % 16; j < at + 16; j += 16) {
+                fill_valid(&buf[j], 16);
+            }
+        }
+    }
+
+    free(buf);
+}
+
+void test_validate_file(void)
+{
+    char src_path[] = "/tmp/test_validate_src_XXXXXX";
+    char dst_path[] = "/tmp/test_validate_dst_XXXXXX";
+    utf_rune expected[5] = { 0x03BA, 0x1F79, 0x03C3, 0x03BC, 0x03B5 };
+    utf_rune runes[8];
+    utf_validation_s result;
+    FILE* f;
+    int fd;
+
+    fd = mkstemp(src_path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL(11, write(fd, kosme, 11));
+    TEST_ASSERT_EQUAL(1, write(fd, "\xCE", 1));
+    close(fd);
+
+    fd = mkstemp(dst_path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    TEST_ASSERT_EQUAL(0, utf_validate_file(src_path, &result));
+    TEST_ASSERT_EQUAL(11, result.offset);
+    TEST_ASSERT_EQUAL(5, result.runes);
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, result.error);
+
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_transcode_file(src_path, dst_path,
+                      UTF_ENCODING_UTF8, UTF_ENCODING_UTF32));
+
+    f = fopen(dst_path, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(5, fread(runes, sizeof(utf_rune), 8, f));
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, runes, 5);
+    fclose(f);
+
+    /* Back to UTF-8 by way of UTF-16. */
+    TEST_ASSERT_EQUAL(UTF_ETRUNC, utf_transcode_file(src_path, dst_path,
+                      UTF_ENCODING_UTF8, UTF_ENCODING_UTF16BE));
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, utf_transcode_file(dst_path, src_path,
+                      UTF_ENCODING_UTF16BE, UTF_ENCODING_UTF8));
+    TEST_ASSERT_EQUAL(0, utf_validate_file(src_path, &result));
+    TEST_ASSERT_EQUAL(11, result.offset);
+    TEST_ASSERT_EQUAL(UTF_SUCCESS, result.error);
+    TEST_ASSERT_EQUAL(-1, utf_transcode_file(src_path, dst_path,
+                      UTF_ENCODING_UTF16LE, UTF_ENCODING_UTF32));
+
+    TEST_ASSERT_EQUAL(-1, utf_validate_file("/nonexistent/file", &result));
+
+    unlink(dst_path);
+    unlink(src_path);
+}
+
+void test_validate_file_not_regular(void)
+{
+    char fifo_path[] = "/tmp/test_validate_fifo_XXXXXX";
+    char dst_path[] = "/tmp/test_validate_dst_XXXXXX";
+    utf_validation_s result;
+    int fd;
+
+    /* Devices, FIFOs and directories have no size to map, so reading them in
+     * place would see them as empty. */
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, utf_validate_file("/dev/null", &result));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, utf_validate_file("/tmp", &result));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+
+    /* A FIFO without a writer must not block. */
+    fd = mkstemp(fifo_path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+    unlink(fifo_path);
+    TEST_ASSERT_EQUAL(0, mkfifo(fifo_path, 0600));
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, utf_validate_file(fifo_path, &result));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+    unlink(fifo_path);
+
+    fd = mkstemp(dst_path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, utf_transcode_file("/dev/null", dst_path,
+                      UTF_ENCODING_UTF8, UTF_ENCODING_UTF32));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+    unlink(dst_path);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    if (TEST_PROTECT()) {
+        RUN_TEST(test_validstring_empty);
+        RUN_TEST(test_validstring_ascii);
+        RUN_TEST(test_validstring_multibyte);
+        RUN_TEST(test_validstring_truncated);
+        RUN_TEST(test_validstring_unexpected_continuation);
+        RUN_TEST(test_validstring_overlong);
+        RUN_TEST(test_validstring_surrogate);
+        RUN_TEST(test_validstring_too_large);
+        RUN_TEST(test_validstring_nonchar);
+        RUN_TEST(test_validstring_bf_tail);
+        RUN_TEST(test_runecount);
+        RUN_TEST(test_runecount_valid_stops);
+        RUN_TEST(test_utf16len);
+        RUN_TEST(test_runenlen);
+        RUN_TEST(test_runenlen_stops);
+        RUN_TEST(test_validate_ex);
+        RUN_TEST(test_validate_mt);
+        RUN_TEST(test_validate_file);
+        RUN_TEST(test_validate_file_not_regular);
+    }
+    return UNITY_END();
+}